@@ -0,0 +1,103 @@
+/***************************************************************
+* Description: Header file for the AABB class, an axis-aligned *
+*              bounding box used by acceleration structures.   *
+***************************************************************/
+
+#ifndef AABB_H
+#define AABB_H
+
+#include "rt_general.h" // Include necessary header files.
+
+#include <utility> // Include necessary standard library headers.
+
+// Class representing an axis-aligned bounding box as one interval per axis.
+class aabb {
+public:
+    interval x, y, z; // Extent of the box along each axis.
+
+    // Constructors:
+    aabb() {} // Default constructor creates an empty box, since intervals start out empty.
+    aabb(const interval& x, const interval& y, const interval& z) : x(x), y(y), z(z) {}
+
+    // Box spanning two corner points, given in any order.
+    aabb(const point3& a, const point3& b) {
+        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+    }
+
+    // Smallest box enclosing two boxes.
+    aabb(const aabb& box0, const aabb& box1) {
+        x = interval(box0.x, box1.x);
+        y = interval(box0.y, box1.y);
+        z = interval(box0.z, box1.z);
+    }
+
+    // Return the interval of the box along axis n (0 = x, 1 = y, 2 = z).
+    const interval& axis_interval(int n) const {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    // Check whether the box holds no points.
+    bool is_empty() const {
+        return x.min > x.max || y.min > y.max || z.min > z.max;
+    }
+
+    // Center point of the box.
+    point3 centroid() const {
+        return point3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max));
+    }
+
+    // Index of the axis along which the box is longest.
+    int longest_axis() const {
+        if (x.size() > y.size()) {
+            return x.size() > z.size() ? 0 : 2;
+        }
+        return y.size() > z.size() ? 1 : 2;
+    }
+
+    // Surface area of the box, the cost estimate used by the SAH build.
+    double surface_area() const {
+        if (is_empty()) {
+            return 0;
+        }
+        auto dx = x.size(), dy = y.size(), dz = z.size();
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    // Check whether a ray passes through the box within ray_t (slab test).
+    bool hit(const ray& r, interval ray_t) const {
+        const point3& ray_orig = r.origin();
+        const vec3& ray_dir = r.direction();
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& ax = axis_interval(axis);
+            const double adinv = 1.0 / ray_dir[axis];
+
+            auto t0 = (ax.min - ray_orig[axis]) * adinv; // Entry and exit distances for this slab.
+            auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+
+            if (ray_t.max <= ray_t.min) {
+                return false; // Slabs do not overlap: the ray misses the box.
+            }
+        }
+        return true;
+    }
+
+    // Static constants representing an empty and a universal box.
+    static const aabb empty, universe;
+};
+
+// Define static constants representing an empty box and a universal box.
+const aabb aabb::empty = aabb(interval::empty, interval::empty, interval::empty);
+const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+
+#endif // AABB_H
@@ -0,0 +1,97 @@
+/***************************************************************
+* Description: Header file for the accumulation_buffer class,  *
+*              which holds per-pixel sample sums and counts of *
+*              a frame that is rendered in parts.              *
+***************************************************************/
+
+#ifndef ACCUMULATION_H
+#define ACCUMULATION_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "framebuffer.h"
+
+#include <vector> // Include necessary standard library headers.
+
+// Class holding, for every pixel, the sum of the samples taken so far (in double) and their
+// count. Partial renders of a frame (tile ranges, sample ranges) add into it or are merged into
+// one, and resolve() turns it into an image. A pixel rendered in one piece resolves to exactly the
+// value the camera would store directly.
+class accumulation_buffer {
+public:
+    // Constructors:
+    accumulation_buffer() {} // Default constructor creates an empty 0x0 buffer.
+    accumulation_buffer(int width, int height) { resize(width, height); }
+
+    // Change the buffer size; every pixel becomes empty.
+    void resize(int width, int height) {
+        w = (width < 0) ? 0 : width;
+        h = (height < 0) ? 0 : height;
+        sums.assign(size_t(w) * h * 3, 0.0);
+        counts.assign(size_t(w) * h, 0);
+    }
+
+    // Accessor functions for the buffer size.
+    int width() const { return w; }
+    int height() const { return h; }
+
+    // Add a sum of n samples to pixel (x, y).
+    void add(int x, int y, const color& sum, int n) {
+        size_t i = size_t(y) * w + x;
+        sums[3 * i] += double(sum.x());
+        sums[3 * i + 1] += double(sum.y());
+        sums[3 * i + 2] += double(sum.z());
+        counts[i] += n;
+    }
+
+    // Sample sum and count of pixel (x, y).
+    color sum(int x, int y) const {
+        size_t i = size_t(y) * w + x;
+        return color(real(sums[3 * i]), real(sums[3 * i + 1]), real(sums[3 * i + 2]));
+    }
+    int count(int x, int y) const { return counts[size_t(y) * w + x]; }
+
+    // Add the rows [y0, y1) of another buffer, given as raw sums and counts (as sent between
+    // processes): sums holds 3 values and counts 1 value per pixel of those rows.
+    void merge_rows(int y0, int y1, const double* row_sums, const int* row_counts) {
+        size_t first = size_t(y0) * w, n = size_t(y1 - y0) * w;
+        for (size_t i = 0; i < 3 * n; i++) {
+            sums[3 * first + i] += row_sums[i];
+        }
+        for (size_t i = 0; i < n; i++) {
+            counts[first + i] += row_counts[i];
+        }
+    }
+
+    // Add another buffer of the same size.
+    void merge(const accumulation_buffer& other) {
+        merge_rows(0, h, other.sums.data(), other.counts.data());
+    }
+
+    // Write the mean of every pixel to an image of the same size; pixels without samples are black.
+    void resolve(framebuffer& image) const {
+        image.resize(w, h);
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                int n = count(x, y);
+                if (n > 0) {
+                    image.set(x, y, (1.0 / n) * sum(x, y));
+                }
+            }
+        }
+    }
+
+    // Samples taken per pixel, row by row from the top.
+    const std::vector<int>& sample_counts() const { return counts; }
+
+    // Raw access to the interleaved RGB sums (width * height * 3 values) and the counts.
+    const double* sum_data() const { return sums.data(); }
+    const int* count_data() const { return counts.data(); }
+
+private:
+    int w = 0; // Width in pixels.
+    int h = 0; // Height in pixels.
+    std::vector<double> sums; // Interleaved RGB sample sums.
+    std::vector<int> counts; // Samples per pixel.
+};
+
+#endif // ACCUMULATION_H
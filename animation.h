@@ -0,0 +1,356 @@
+/***************************************************************
+* Description: Header file for animated sequences: objects    *
+*              that move from frame to frame, scenes refit to  *
+*              each frame, and pipelined sequence rendering.   *
+***************************************************************/
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "sphere.h"
+#include "instance.h"
+#include "transform.h"
+#include "bvh.h"
+#include "primitive_store.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "scene_file.h"
+#include "thread_pool.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Values at key frames, interpolated linearly in between and held before the first key and after
+// the last one.
+template <typename T>
+class keyframes {
+public:
+    // Add a key; keys may come in any order.
+    void add(double frame, const T& value) {
+        auto later = std::upper_bound(keys.begin(), keys.end(), frame,
+                                      [](double f, const std::pair<double, T>& key) { return f < key.first; });
+        keys.insert(later, {frame, value});
+    }
+
+    bool empty() const { return keys.empty(); }
+
+    // Value at a frame. There must be at least one key.
+    T at(double frame) const {
+        if (frame <= keys.front().first) {
+            return keys.front().second;
+        }
+        if (frame >= keys.back().first) {
+            return keys.back().second;
+        }
+        auto next = std::upper_bound(keys.begin(), keys.end(), frame,
+                                     [](double f, const std::pair<double, T>& key) { return f < key.first; });
+        auto previous = next - 1;
+        double s = (frame - previous->first) / (next->first - previous->first);
+        return previous->second + s * (next->second - previous->second);
+    }
+
+private:
+    std::vector<std::pair<double, T>> keys; // (frame, value), by frame.
+};
+
+// An animated scene. Static primitives are built into one BVH for the whole sequence; moving ones
+// are placed anew for every frame by animation_frame. Add objects, call build(), then render.
+class animation {
+public:
+    int frame_count = 1; // Frames in the sequence.
+
+    // Add a sphere that stays put.
+    void add(const sphere& s) { statics.add(s); }
+
+    // Add any other hittable that stays put.
+    void add(shared_ptr<hittable> object) { statics.add(std::move(object)); }
+
+    // Add a sphere of the given radius whose center follows path.
+    void add_moving(const keyframes<point3>& path, real radius) {
+        moving_spheres.push_back({path, radius});
+    }
+
+    // Add an object (typically a shared triangle_mesh) placed by placement(frame) in every frame.
+    void add_moving(shared_ptr<hittable> object, std::function<transform(double)> placement) {
+        moving_objects.push_back({std::move(object), std::move(placement)});
+    }
+
+    // Build the BVH of the static primitives.
+    void build(const bvh_build_options& options = bvh_build_options()) { statics.build(options); }
+
+    // The static primitives, once built.
+    const hittable& static_scene() const { return statics; }
+
+    // Number of moving spheres and objects.
+    size_t moving_sphere_count() const { return moving_spheres.size(); }
+    size_t moving_object_count() const { return moving_objects.size(); }
+
+    // Moving sphere or object number index as it is at a frame.
+    sphere sphere_at(size_t index, double frame) const {
+        const moving_sphere& s = moving_spheres[index];
+        return sphere(s.path.at(frame), s.radius);
+    }
+
+    instance object_at(size_t index, double frame) const {
+        const moving_object& o = moving_objects[index];
+        return instance(o.object, o.placement(frame));
+    }
+
+private:
+    struct moving_sphere {
+        keyframes<point3> path; // Center over time.
+        real radius;
+    };
+
+    struct moving_object {
+        shared_ptr<hittable> object; // Object in its own space.
+        std::function<transform(double)> placement; // Object-to-world transform of each frame.
+    };
+
+    primitive_store<sphere> statics; // Primitives that never move.
+    std::vector<moving_sphere> moving_spheres;
+    std::vector<moving_object> moving_objects;
+};
+
+// Set up an animation from a text scene: spheres with keys move, the others stay put.
+inline void make_animation(const scene_description& scene, animation& anim) {
+    std::vector<keyframes<point3>> paths(scene.sphere_centers.size());
+    for (const auto& key : scene.sphere_keys) {
+        paths[key.sphere].add(key.frame, key.center);
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (paths[i].empty()) {
+            anim.add(sphere(scene.sphere_centers[i], real(scene.sphere_radii[i])));
+        }
+        else {
+            anim.add_moving(paths[i], real(scene.sphere_radii[i]));
+        }
+    }
+    anim.frame_count = scene.frame_count;
+}
+
+// How animation_frame keeps the trees of moving objects up to date.
+struct refit_options {
+    double rebuild_threshold = 1.5; // Rebuild a tree once refitting has raised its SAH cost by this factor (0 = every frame).
+    bvh_build_options build; // Settings of builds.
+};
+
+// One frame of an animation, ready to render: the animation's static BVH plus BVHs over the moving
+// objects as placed for the frame. Going to another frame refits the moving trees to the objects'
+// new places instead of building them again, unless refitting has made them too slow.
+class animation_frame : public hittable {
+public:
+    // Place the moving objects for a frame. The first call builds their trees. The animation must
+    // be built, and must outlive the frame without changing.
+    void update(const animation& anim, double frame, const refit_options& options = refit_options()) {
+        bool first = source != &anim;
+        source = &anim;
+        update_tree(spheres, anim.moving_sphere_count(), first, options,
+                    [&](size_t index) { return anim.sphere_at(index, frame); });
+        update_tree(objects, anim.moving_object_count(), first, options,
+                    [&](size_t index) { return anim.object_at(index, frame); });
+        bbox = aabb(anim.static_scene().bounding_box(), aabb(spheres.bounding_box(), objects.bounding_box()));
+    }
+
+    // Trees refit and built so far.
+    int refits() const { return refit_count; }
+    int builds() const { return build_count; }
+
+    // Method to check for ray-object intersection with the static and moving objects.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        bool hit_anything = false;
+        for (const hittable* tree : trees()) {
+            if (tree->hit(r, ray_t, rec)) {
+                hit_anything = true;
+                ray_t.max = rec.t; // Later trees only need to find closer hits.
+            }
+        }
+        return hit_anything;
+    }
+
+    // Method to trace a packet of rays, one tree after the other; the closest hit per ray wins.
+    void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const override {
+        for (int k = 0; k < count; k++) {
+            hits[k] = false;
+        }
+        hit_record tree_recs[max_packet_size];
+        bool tree_hits[max_packet_size];
+        for (const hittable* tree : trees()) {
+            tree->hit_packet(rays, count, ray_t, tree_recs, tree_hits);
+            for (int k = 0; k < count; k++) {
+                if (tree_hits[k] && (!hits[k] || tree_recs[k].t < recs[k].t)) {
+                    hits[k] = true;
+                    recs[k] = tree_recs[k];
+                }
+            }
+        }
+    }
+
+    // Method to check whether the ray hits anything in the frame.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        for (const hittable* tree : trees()) {
+            if (tree->any_hit(r, ray_t)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Method returning the bounding box of the frame.
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    const animation* source = nullptr; // Animation the frame was placed from.
+    basic_bvh<sphere> spheres; // Moving spheres.
+    basic_bvh<instance> objects; // Moving objects.
+    aabb bbox; // Bounding box of everything.
+    int refit_count = 0, build_count = 0;
+
+    std::array<const hittable*, 3> trees() const { return {&source->static_scene(), &spheres, &objects}; }
+
+    // Refit a tree to primitives placed by place(index), or build it when it is new, the
+    // primitive count changed or its cost has grown past the threshold.
+    template <typename Primitive, typename Place>
+    void update_tree(basic_bvh<Primitive>& tree, size_t count, bool first, const refit_options& options, Place&& place) {
+        if (count == 0) {
+            return;
+        }
+        if (!first && tree.primitives().size() == count && options.rebuild_threshold > 0) {
+            tree.refit([&](Primitive& primitive, int index) { primitive = place(size_t(index)); });
+            if (tree.cost_growth() <= options.rebuild_threshold) {
+                refit_count++;
+                return;
+            }
+        }
+        std::vector<Primitive> placed;
+        placed.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            placed.push_back(place(i));
+        }
+        tree = basic_bvh<Primitive>(std::move(placed), options.build);
+        build_count++;
+    }
+};
+
+// Path of a frame's image: the last run of '#' in pattern becomes the frame number, padded with
+// zeros to the run's length; without '#', "_<frame>" goes before the extension.
+inline std::string frame_path(const std::string& pattern, int frame) {
+    auto last = pattern.rfind('#');
+    if (last == std::string::npos) {
+        auto dot = pattern.rfind('.');
+        auto slash = pattern.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            dot = pattern.size();
+        }
+        return frame_path(pattern.substr(0, dot) + "_####" + pattern.substr(dot), frame);
+    }
+    auto first = pattern.find_last_not_of('#', last);
+    first = (first == std::string::npos) ? 0 : first + 1;
+    char number[32];
+    std::snprintf(number, sizeof(number), "%0*d", int(last + 1 - first), frame);
+    return pattern.substr(0, first) + number + pattern.substr(last + 1);
+}
+
+// Settings of a sequence render.
+struct sequence_options {
+    std::string output_pattern; // Image path of each frame, see frame_path() (empty = render without writing).
+    image_format format = image_format::unknown; // Image format (unknown = from each path's extension).
+    int thread_count = 0; // Threads shared by rendering, scene updates and image writing (0 = every hardware thread).
+    refit_options refit; // When moving trees are refit or rebuilt.
+    bool show_progress = true; // Print a line as each frame finishes.
+};
+
+// What a sequence render did.
+struct sequence_report {
+    int frames = 0; // Frames rendered.
+    uint64_t rays = 0; // Rays traced by all frames.
+    double seconds = 0; // Wall-clock time of the whole sequence.
+    double update_seconds = 0; // Time spent placing moving objects for the frames, overlapped with rendering.
+    int refits = 0; // Moving trees refit to a new frame.
+    int builds = 0; // Moving trees built, the first ones included.
+};
+
+// Render every frame of an animation with cam and write the images. Frames are pipelined on one
+// thread pool: while frame N renders, the moving objects are placed for frame N + 1 (in a second
+// animation_frame, so the one being rendered never changes) and frame N - 1 is encoded and
+// written. Every frame is the image a render of a scene built from scratch for it gives. Returns
+// false and sets error if an image cannot be written; the sequence stops there.
+inline bool render_sequence(const animation& anim, camera& cam, const sequence_options& options,
+                            sequence_report& report, std::string& error) {
+    report = sequence_report();
+    if (options.format == image_format::unknown && !options.output_pattern.empty() &&
+        image_format_from_path(frame_path(options.output_pattern, 0)) == image_format::unknown) {
+        error = "unknown image format: " + options.output_pattern;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    thread_pool pool(options.thread_count);
+    cam.pool = &pool;
+    bool show_progress = cam.show_progress;
+    cam.show_progress = false; // Frame lines instead of tile progress.
+
+    animation_frame scenes[2]; // The frame being rendered, and the next one being placed meanwhile.
+    framebuffer images[2]; // The frame being rendered, and the previous one being written meanwhile.
+    std::mutex report_mutex; // Guards report.update_seconds and error.
+    auto place = [&](int slot, int frame) {
+        auto place_start = std::chrono::steady_clock::now();
+        scenes[slot].update(anim, frame, options.refit);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - place_start).count();
+        std::lock_guard<std::mutex> lock(report_mutex);
+        report.update_seconds += seconds;
+    };
+
+    place(0, 0);
+    task_group updates(pool), writes(pool);
+    bool written = true;
+    for (int frame = 0; frame < anim.frame_count && written; frame++) {
+        int slot = frame % 2;
+        if (frame + 1 < anim.frame_count) {
+            updates.run([&, slot, frame] { place(1 - slot, frame + 1); });
+        }
+        cam.render(scenes[slot], images[slot]);
+        report.rays += cam.rays_traced();
+        report.frames++;
+        updates.wait();
+        writes.wait(); // The previous frame is written, and its image free for the next one.
+
+        std::lock_guard<std::mutex> lock(report_mutex);
+        written = error.empty();
+        if (options.show_progress) {
+            std::clog << "Frame " << frame + 1 << " of " << anim.frame_count << " (" << cam.seconds() << " s)\n";
+        }
+        if (written && !options.output_pattern.empty()) {
+            writes.run([&, slot, frame] {
+                std::string path = frame_path(options.output_pattern, frame);
+                image_format format = (options.format == image_format::unknown) ? image_format_from_path(path) : options.format;
+                if (!write_image(path, format, images[slot])) {
+                    std::lock_guard<std::mutex> lock(report_mutex);
+                    error = "could not write " + path;
+                }
+            });
+        }
+    }
+    writes.wait();
+
+    cam.pool = nullptr; // The pool is gone.
+    cam.show_progress = show_progress;
+    for (const auto& scene : scenes) {
+        report.refits += scene.refits();
+        report.builds += scene.builds();
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return error.empty();
+}
+
+#endif // ANIMATION_H
@@ -0,0 +1,37 @@
+/***************************************************************
+* Description: Header file for the aov_buffers struct, which   *
+*              holds the auxiliary per-pixel outputs of a      *
+*              render (albedo, normal, depth, noise).          *
+***************************************************************/
+
+#ifndef AOV_H
+#define AOV_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "framebuffer.h"
+
+#include <vector> // Include necessary standard library headers.
+
+// Auxiliary buffers ("arbitrary output variables") of a render, row by row from the top. Values
+// are means over a pixel's samples, so edges are antialiased like the image itself. They guide
+// the denoiser, and are useful on their own for debugging scenes.
+struct aov_buffers {
+    framebuffer albedo; // Reflectance of the first surface hit; the background color where rays miss.
+    framebuffer normal; // Normal of the first hit (facing the ray); zero where rays miss.
+    std::vector<float> depth; // Distance to the first hit, over the samples that hit (0 = nothing hit).
+    std::vector<float> variance; // Variance of the pixel's mean luminance (its squared standard error).
+
+    // Change the size; every value becomes zero.
+    void resize(int width, int height) {
+        albedo.resize(width, height);
+        normal.resize(width, height);
+        depth.assign(size_t(albedo.width()) * albedo.height(), 0.0f);
+        variance.assign(depth.size(), 0.0f);
+    }
+
+    // Accessor functions for the size.
+    int width() const { return albedo.width(); }
+    int height() const { return albedo.height(); }
+};
+
+#endif // AOV_H
@@ -0,0 +1,83 @@
+/***************************************************************
+* Description: Header file for the object arena, which places  *
+*              scene objects in large shared blocks instead of *
+*              one heap allocation per object.                 *
+***************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "rt_general.h" // Include necessary header files.
+
+#include <algorithm> // Include necessary standard library headers.
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Class allocating objects back to back in blocks. make<T>() returns a shared_ptr that points at
+// the object but shares ownership of its whole block (an aliasing shared_ptr), so objects work
+// anywhere a make_shared object does, without a heap allocation and refcount block each. A block
+// and its objects are destroyed when the arena and every pointer into the block are gone.
+// Not thread-safe; scenes are built on one thread.
+class object_arena {
+public:
+    // Constructors:
+    explicit object_arena(size_t block_size = 64 * 1024) : block_size(block_size) {}
+
+    // Construct a T in the arena.
+    template <typename T, typename... Args>
+    shared_ptr<T> make(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            current->destructors.push_back({object, [](void* p) { static_cast<T*>(p)->~T(); }});
+        }
+        return shared_ptr<T>(current, object); // Aliasing constructor: owns the block, points at the object.
+    }
+
+    // Bytes handed out so far.
+    size_t bytes_used() const { return total_used; }
+
+private:
+    struct block {
+        std::vector<std::max_align_t> storage; // Raw memory, aligned for any standard type.
+        size_t used = 0; // Bytes handed out.
+        std::vector<std::pair<void*, void (*)(void*)>> destructors; // Objects to destroy, in construction order.
+
+        explicit block(size_t size) : storage((size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t)) {}
+        ~block() {
+            for (auto it = destructors.rbegin(); it != destructors.rend(); ++it) {
+                it->second(it->first); // Destroy in reverse order, like a stack.
+            }
+        }
+        size_t capacity() const { return storage.size() * sizeof(std::max_align_t); }
+        unsigned char* bytes() { return reinterpret_cast<unsigned char*>(storage.data()); }
+    };
+
+    size_t block_size; // Size of a regular block.
+    size_t total_used = 0; // Bytes handed out over all blocks.
+    shared_ptr<block> current; // Block being filled.
+
+    // Find size bytes at the given alignment, starting a new block when the current one is full.
+    void* allocate(size_t size, size_t align) {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (current) {
+                uintptr_t start = reinterpret_cast<uintptr_t>(current->bytes());
+                uintptr_t address = (start + current->used + align - 1) / align * align;
+                size_t offset = size_t(address - start);
+                if (offset + size <= current->capacity()) {
+                    current->used = offset + size;
+                    total_used += size;
+                    return current->bytes() + offset;
+                }
+            }
+            current = make_shared<block>(std::max(block_size, size + align)); // Room for the object at any alignment.
+        }
+        throw std::bad_alloc(); // Unreachable: a fresh block always fits the object.
+    }
+};
+
+#endif // ARENA_H
@@ -0,0 +1,180 @@
+/***************************************************************
+* Description: Header file for batch rendering: many camera    *
+*              jobs rendered against one shared scene on one   *
+*              shared thread pool.                             *
+***************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "thread_pool.h"
+
+#include <chrono> // Include necessary standard library headers.
+#include <iostream>
+#include <istream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// One frame of a batch: a camera (view, resolution, samples) and where its image goes.
+struct render_job {
+    camera cam; // Camera of the frame; its pool and progress settings are set by render_batch.
+    std::string output_path; // Image file; the format follows the extension.
+};
+
+// Parse camera settings given as keyword/value pairs, up to the end of fields, onto cam:
+//
+//     lookfrom 0 4 -1  lookat 0 0 -1  vup 0 0 -1  vfov 40  width 1920  aspect 1.7778  spp 100  max_depth 20  seed 7
+//
+// Check that a camera's view can be set up: lookat differs from lookfrom and vup is not along the
+// view direction. Returns false and sets error otherwise.
+inline bool check_camera_view(const camera& cam, std::string& error) {
+    vec3 backwards = cam.lookfrom - cam.lookat;
+    if (backwards.length_squared() == 0 || cross(cam.vup, backwards).length_squared() == 0) {
+        error = "lookat must differ from lookfrom, and vup must not point along the view";
+        return false;
+    }
+    return true;
+}
+
+// Returns false and sets error on an unknown keyword, bad values or an impossible view. With
+// check_view false the view is left for the caller to check once all its settings are known.
+inline bool parse_camera_settings(std::istream& fields, camera& cam, std::string& error, bool check_view = true) {
+    std::string keyword;
+    while (fields >> keyword) {
+        bool ok = true;
+        if (keyword == "lookfrom" || keyword == "lookat" || keyword == "vup") {
+            double x, y, z;
+            ok = bool(fields >> x >> y >> z);
+            vec3& target = (keyword == "lookfrom") ? cam.lookfrom : (keyword == "lookat") ? cam.lookat : cam.vup;
+            target = vec3(x, y, z);
+        }
+        else if (keyword == "vfov") ok = bool(fields >> cam.vfov) && cam.vfov > 0 && cam.vfov < 180;
+        else if (keyword == "width") ok = bool(fields >> cam.image_width) && cam.image_width > 0;
+        else if (keyword == "aspect") ok = bool(fields >> cam.aspect_ratio) && cam.aspect_ratio > 0;
+        else if (keyword == "spp") ok = bool(fields >> cam.samples_per_pixel) && cam.samples_per_pixel > 0;
+        else if (keyword == "max_depth") ok = bool(fields >> cam.max_depth);
+        else if (keyword == "seed") ok = bool(fields >> cam.seed);
+        else {
+            error = "unknown keyword '" + keyword + "'";
+            return false;
+        }
+
+        if (!ok) {
+            error = "bad values for '" + keyword + "'";
+            return false;
+        }
+    }
+
+    return !check_view || check_camera_view(cam, error);
+}
+
+// Parse a batch job list. Each line is one job: its output path, then camera settings (see
+// parse_camera_settings) that override the defaults camera; '#' starts a comment:
+//
+//     front.png  lookfrom 0 0 0   lookat 0 0 -1  vfov 90  width 400  aspect 1.7778  spp 100
+//     top.png    lookfrom 0 4 -1  lookat 0 0 -1  vup 0 0 -1  vfov 40  width 1920  max_depth 20  seed 7
+//
+// Returns false and sets error on malformed input.
+inline bool parse_batch_text(std::istream& in, const camera& defaults, std::vector<render_job>& jobs, std::string& error) {
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        auto hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash); // Strip comments.
+        }
+
+        std::istringstream fields(line);
+        render_job job;
+        if (!(fields >> job.output_path)) {
+            continue; // Blank line.
+        }
+        if (image_format_from_path(job.output_path) == image_format::unknown) {
+            error = "line " + std::to_string(line_number) + ": unknown image format: " + job.output_path;
+            return false;
+        }
+        job.cam = defaults;
+        if (!parse_camera_settings(fields, job.cam, error)) {
+            error = "line " + std::to_string(line_number) + ": " + error;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Settings of a batch render.
+struct batch_options {
+    int thread_count = 0; // Threads shared by all jobs (0 = use every hardware thread).
+    bool show_progress = true; // Print a line as each job finishes.
+};
+
+// What a batch render did.
+struct batch_report {
+    int frames = 0; // Jobs rendered and written.
+    uint64_t rays = 0; // Rays traced by all jobs.
+    double seconds = 0; // Wall-clock time of the whole batch.
+};
+
+// Render every job against world and write its image. All jobs share one thread pool: each job is
+// a task, and its tiles are tasks of the same pool, so a thread that runs out of tiles in one
+// frame helps with the next frame instead of idling at the frame's end. The scene and its
+// acceleration structures are built once by the caller and only read. Frames may finish in any
+// order; every frame is still the image a single render of its camera gives. Returns false and
+// sets error (naming the first failed job) if an image cannot be written; the other jobs still run.
+inline bool render_batch(std::vector<render_job>& jobs, const hittable& world, const batch_options& options,
+                         batch_report& report, std::string& error) {
+    report = batch_report();
+    auto start = std::chrono::steady_clock::now();
+    std::mutex report_mutex; // Guards report, failures and progress output.
+    std::vector<std::string> failures(jobs.size()); // Error of each job, if any.
+
+    thread_pool pool(options.thread_count);
+    task_group frames(pool);
+    for (size_t j = 0; j < jobs.size(); j++) {
+        frames.run([&, j] {
+            render_job& job = jobs[j];
+            job.cam.pool = &pool;
+            job.cam.show_progress = false; // Tile progress of interleaved frames would be noise.
+
+            framebuffer image;
+            job.cam.render(world, image);
+            bool written = write_image(job.output_path, image_format_from_path(job.output_path), image);
+
+            std::lock_guard<std::mutex> lock(report_mutex);
+            if (!written) {
+                failures[j] = "could not write " + job.output_path;
+                return;
+            }
+            report.frames++;
+            report.rays += job.cam.rays_traced();
+            if (options.show_progress) {
+                std::clog << "Frame " << report.frames << " of " << jobs.size() << ": " << job.output_path << " ("
+                          << job.cam.seconds() << " s)\n";
+            }
+        });
+    }
+    frames.wait();
+
+    for (size_t j = 0; j < jobs.size(); j++) {
+        jobs[j].cam.pool = nullptr; // The pool is gone.
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto& failure : failures) {
+        if (!failure.empty()) {
+            error = failure;
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // BATCH_H
@@ -0,0 +1,548 @@
+/***************************************************************
+* Description: Rendering benchmark. Renders a set of fixed     *
+*              scenes, reports throughput as JSON, and can     *
+*              check it against a stored baseline.             *
+***************************************************************/
+
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "rt_general.h"
+#include "hittable_list.h"
+#include "sphere.h"
+#include "bvh.h"
+#include "primitive_store.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "stats.h"
+#include "denoise.h"
+#include "animation.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+// Settings shared by every benchmark scene.
+struct bench_settings {
+    int image_width = 400; // Image width; the aspect ratio is always 16:9.
+    int samples_per_pixel = 32; // Samples per pixel.
+    int max_depth = 50; // Maximum bounces.
+    int thread_count = 0; // Render threads (0 = all hardware threads).
+    int packet_size = 0; // Primary ray packet edge (0 = single rays).
+    bool typed_store = true; // Spheres by value in a primitive_store, or shared_ptrs in a hittable_list.
+    bool denoise = false; // Denoise each frame with its auxiliary buffers.
+    integrator engine = integrator::path; // How the camera traces paths.
+    ray_sort sort = ray_sort::direction; // Ray order of the wavefront engine.
+    int queue_size = 0; // Paths in flight per thread in the wavefront engine (0 = camera default).
+    sampler_kind sampler = sampler_kind::independent; // How samples choose their numbers.
+    int frames = 0; // Render each scene as an animated sequence of this many frames (0 = one still frame).
+    double rebuild_threshold = refit_options().rebuild_threshold; // When a sequence rebuilds its moving tree.
+    std::string image_prefix; // Write each frame to <prefix><scene>.pfm, if set.
+    std::string reference_prefix; // Compare each frame with <prefix><scene>.pfm, if set.
+};
+
+// Results of one benchmark scene.
+struct bench_result {
+    std::string scene; // Scene name.
+    std::string engine; // Integrator that rendered the frame.
+    std::string sampler; // Sampler of the frame.
+    int samples_per_pixel = 0; // Samples per pixel of the frame.
+    size_t primitives = 0; // Number of spheres.
+    int width = 0, height = 0; // Image size.
+    double build_seconds = 0; // Time to build the acceleration structure.
+    double frame_seconds = 0; // Time to render the frame.
+    uint64_t rays = 0; // Rays traced.
+    double rays_per_second = 0;
+    uint64_t node_tests = 0; // Ray-box tests against BVH nodes.
+    uint64_t primitive_tests = 0; // Ray-sphere tests.
+    double tests_per_second = 0; // Node plus primitive tests per second.
+    long peak_rss_kb = 0; // Peak resident set size of the process so far.
+    double rmse = -1; // Root mean square error against a reference image (-1 = not compared).
+    double denoise_seconds = -1; // Time to denoise the frame (-1 = not denoised).
+    double rmse_denoised = -1; // RMSE of the denoised frame against the reference (-1 = not compared).
+    int frames = 0; // Frames of a sequence (0 = a still frame).
+    size_t moving = 0; // Moving spheres of a sequence.
+    double update_seconds = 0; // Time per frame to place the moving spheres.
+    int refits = 0, builds = 0; // Moving trees refit and built over the sequence.
+};
+
+
+// Peak resident set size of this process in kilobytes (0 where unavailable).
+long peak_rss_kb() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return long(usage.ru_maxrss / 1024); // Reported in bytes on macOS.
+#else
+        return long(usage.ru_maxrss);
+#endif
+    }
+#endif
+    return 0;
+}
+
+
+// Root mean square difference of two images over all channels (-1 if their sizes differ).
+double image_rmse(const framebuffer& a, const framebuffer& b) {
+    if (a.width() != b.width() || a.height() != b.height()) {
+        return -1;
+    }
+    size_t n = size_t(a.width()) * a.height() * 3;
+    double sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        double d = double(a.data()[i]) - b.data()[i];
+        sum += d * d;
+    }
+    return std::sqrt(sum / n);
+}
+
+
+// List the spheres of a benchmark scene by name: "demo" is the two-sphere scene from main.cpp,
+// "spheres_<n>" puts n random spheres (same seed every run) on the demo's ground sphere.
+bool make_scene(const std::string& name, std::vector<sphere>& world) {
+    world.emplace_back(point3(0,-100.5,-1),100); // Ground.
+    if (name == "demo") {
+        world.emplace_back(point3(0,0,-1), 0.5);
+        return true;
+    }
+    if (name.rfind("spheres_", 0) != 0) {
+        return false;
+    }
+
+    long count = std::atol(name.c_str() + 8);
+    if (count <= 0) {
+        return false;
+    }
+    rng gen(2024, 0);
+    double radius = 0.6 / std::cbrt(double(count)); // Keep the spheres' total volume roughly constant.
+    for (long i = 0; i < count; i++) {
+        point3 center(random_double(gen, -3, 3), random_double(gen, -0.5, 1.5), random_double(gen, -5, -1));
+        world.emplace_back(center, radius * random_double(gen, 0.5, 1.5));
+    }
+    return true;
+}
+
+
+// Camera for the benchmark settings.
+camera make_camera(const bench_settings& settings) {
+    camera cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = settings.image_width;
+    cam.samples_per_pixel = settings.samples_per_pixel;
+    cam.max_depth = settings.max_depth;
+    cam.thread_count = settings.thread_count;
+    cam.show_progress = false; // Progress lines would interleave with the JSON output.
+    cam.packet_size = settings.packet_size;
+    cam.record_aovs = settings.denoise;
+    cam.engine = settings.engine;
+    cam.sampler = settings.sampler;
+    cam.wavefront.sort = settings.sort;
+    if (settings.queue_size > 0) {
+        cam.wavefront.queue_size = settings.queue_size;
+    }
+    return cam;
+}
+
+
+// Render one scene and measure it.
+bool run_scene(const std::string& name, const bench_settings& settings, bench_result& result) {
+    std::vector<sphere> spheres;
+    if (!make_scene(name, spheres)) {
+        std::cerr << "Unknown scene: " << name << '\n';
+        return false;
+    }
+
+    // Build the scene as configured; build time includes creating the objects.
+    auto start = std::chrono::steady_clock::now();
+    hittable_list world;
+    shared_ptr<hittable> scene;
+    if (settings.typed_store) {
+        auto store = make_shared<primitive_store<sphere>>();
+        for (const auto& s : spheres) {
+            store->add(s);
+        }
+        store->build();
+        scene = store;
+    }
+    else {
+        for (const auto& s : spheres) {
+            world.add(make_shared<sphere>(s));
+        }
+        scene = make_shared<bvh>(world);
+    }
+    result.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    camera cam = make_camera(settings);
+    framebuffer image, denoised;
+    cam.render(*scene, image);
+    if (settings.denoise) {
+        auto denoise_start = std::chrono::steady_clock::now();
+        denoise_options options;
+        options.thread_count = settings.thread_count;
+        denoise(image, cam.aovs(), denoised, options);
+        result.denoise_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - denoise_start).count();
+    }
+    const render_counters& counters = cam.stats();
+
+    result.scene = name;
+    result.engine = (settings.engine == integrator::wavefront) ? "wavefront" : "path";
+    result.sampler = sampler_name(settings.sampler);
+    result.samples_per_pixel = settings.samples_per_pixel;
+    result.primitives = spheres.size();
+    result.width = image.width();
+    result.height = image.height();
+    result.frame_seconds = cam.seconds();
+    result.rays = cam.rays_traced();
+    result.rays_per_second = cam.rays_per_second();
+    result.node_tests = counters.node_tests;
+    result.primitive_tests = counters.primitive_tests;
+    result.tests_per_second = (result.frame_seconds > 0) ? (counters.node_tests + counters.primitive_tests) / result.frame_seconds : 0;
+    result.peak_rss_kb = peak_rss_kb();
+
+    if (!settings.image_prefix.empty() && !write_image(settings.image_prefix + name + ".pfm", image_format::pfm, image)) {
+        std::cerr << "Could not write " << settings.image_prefix << name << ".pfm\n";
+        return false;
+    }
+    if (!settings.image_prefix.empty() && settings.denoise &&
+        !write_image(settings.image_prefix + name + "_denoised.pfm", image_format::pfm, denoised)) {
+        std::cerr << "Could not write " << settings.image_prefix << name << "_denoised.pfm\n";
+        return false;
+    }
+    if (!settings.reference_prefix.empty()) {
+        byte_buffer bytes;
+        framebuffer reference;
+        std::string path = settings.reference_prefix + name + ".pfm", error;
+        if (!read_file(path, bytes) || !decode_pfm(bytes, reference, error)) {
+            std::cerr << "Cannot read reference " << path << (error.empty() ? "" : ": " + error) << '\n';
+            return false;
+        }
+        result.rmse = image_rmse(image, reference);
+        if (settings.denoise) {
+            result.rmse_denoised = image_rmse(denoised, reference);
+        }
+    }
+    return true;
+}
+
+
+// Render a scene as an animated sequence in which every hundredth sphere (at least one) moves along
+// a random straight path, and measure it. build_seconds is the one-off build of the static spheres;
+// frame_seconds and update_seconds are per frame.
+bool run_sequence(const std::string& name, const bench_settings& settings, bench_result& result) {
+    std::vector<sphere> spheres;
+    if (!make_scene(name, spheres)) {
+        std::cerr << "Unknown scene: " << name << '\n';
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    animation anim;
+    anim.frame_count = settings.frames;
+    rng gen(2025, 0);
+    size_t stride = std::min<size_t>(100, spheres.size() - 1);
+    for (size_t i = 0; i < spheres.size(); i++) {
+        if (i == 0 || i % stride != 0) {
+            anim.add(spheres[i]); // The ground and most spheres stay put.
+            continue;
+        }
+        aabb box = spheres[i].bounding_box();
+        point3 center = box.centroid();
+        vec3 offset(random_double(gen, -0.5, 0.5), random_double(gen, -0.5, 0.5), random_double(gen, -0.5, 0.5));
+        keyframes<point3> path;
+        path.add(0, center);
+        path.add(settings.frames - 1, center + offset);
+        anim.add_moving(path, real(0.5 * box.x.size()));
+        result.moving++;
+    }
+    anim.build();
+    result.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    camera cam = make_camera(settings);
+    cam.record_aovs = false;
+    sequence_options options;
+    options.thread_count = settings.thread_count;
+    options.refit.rebuild_threshold = settings.rebuild_threshold;
+    options.show_progress = false;
+    if (!settings.image_prefix.empty()) {
+        options.output_pattern = settings.image_prefix + name + "_####.pfm";
+    }
+    sequence_report report;
+    std::string error;
+    reset_stats();
+    if (!render_sequence(anim, cam, options, report, error)) {
+        std::cerr << error << '\n';
+        return false;
+    }
+    render_counters counters = collect_stats(); // The sequence's pool has shut down and handed in its counts.
+
+    result.scene = name;
+    result.engine = (settings.engine == integrator::wavefront) ? "wavefront" : "path";
+    result.sampler = sampler_name(settings.sampler);
+    result.samples_per_pixel = settings.samples_per_pixel;
+    result.primitives = spheres.size();
+    result.width = cam.image_width;
+    result.height = std::max(1, int(cam.image_width / cam.aspect_ratio));
+    result.frame_seconds = report.seconds / report.frames;
+    result.rays = report.rays;
+    result.rays_per_second = report.rays / report.seconds;
+    result.node_tests = counters.node_tests;
+    result.primitive_tests = counters.primitive_tests;
+    result.tests_per_second = (counters.node_tests + counters.primitive_tests) / report.seconds;
+    result.peak_rss_kb = peak_rss_kb();
+    result.frames = report.frames;
+    result.update_seconds = report.update_seconds / report.frames;
+    result.refits = report.refits;
+    result.builds = report.builds;
+    return true;
+}
+
+
+// Format one result as a single-line JSON object.
+std::string to_json(const bench_result& r) {
+    std::ostringstream out;
+    out << "{\"scene\": \"" << r.scene << "\", \"engine\": \"" << r.engine << "\", \"sampler\": \"" << r.sampler
+        << "\", \"spp\": " << r.samples_per_pixel << ", \"precision\": \"" << (sizeof(real) == sizeof(float) ? "float" : "double")
+        << "\", \"primitives\": " << r.primitives
+        << ", \"width\": " << r.width << ", \"height\": " << r.height
+        << ", \"build_seconds\": " << r.build_seconds << ", \"frame_seconds\": " << r.frame_seconds
+        << ", \"rays\": " << r.rays << ", \"rays_per_second\": " << r.rays_per_second
+        << ", \"node_tests\": " << r.node_tests << ", \"primitive_tests\": " << r.primitive_tests
+        << ", \"intersection_tests_per_second\": " << r.tests_per_second
+        << ", \"peak_rss_kb\": " << r.peak_rss_kb;
+    if (r.rmse >= 0) {
+        out << ", \"rmse\": " << r.rmse;
+    }
+    if (r.denoise_seconds >= 0) {
+        out << ", \"denoise_seconds\": " << r.denoise_seconds;
+    }
+    if (r.rmse_denoised >= 0) {
+        out << ", \"rmse_denoised\": " << r.rmse_denoised;
+    }
+    if (r.frames > 0) {
+        out << ", \"frames\": " << r.frames << ", \"moving\": " << r.moving << ", \"update_seconds\": " << r.update_seconds
+            << ", \"refits\": " << r.refits << ", \"builds\": " << r.builds;
+    }
+    out << "}";
+    return out.str();
+}
+
+
+// Read a number field from a one-line JSON object written by to_json.
+bool json_number(const std::string& line, const std::string& key, double& value) {
+    auto pos = line.find("\"" + key + "\":");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    value = std::atof(line.c_str() + pos + key.size() + 3);
+    return true;
+}
+
+// Read a string field from a one-line JSON object written by to_json.
+bool json_string(const std::string& line, const std::string& key, std::string& value) {
+    auto pos = line.find("\"" + key + "\": \"");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += key.size() + 5;
+    auto end = line.find('"', pos);
+    value = line.substr(pos, end - pos);
+    return end != std::string::npos;
+}
+
+
+// Split a comma-separated list.
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --scenes <a,b,...>       Scenes to run (default: demo and spheres_100 .. spheres_1000000)\n"
+              << "  --quick                  Small frames (160 wide, 8 spp) for fast checks\n"
+              << "  --width <n>, --spp <n>, --depth <n>, --threads <n>   Frame settings (--depth 1 traces primary rays only)\n"
+              << "  --packets <4|8>          Trace primary rays in packets of 4x4 or 8x8 pixels\n"
+              << "  --sampler <kind>         independent (default), stratified, sobol or blue-noise sample patterns\n"
+              << "  --spp-list <a,b,...>     Render each scene at every sample count (with --reference: error vs spp)\n"
+              << "  --engine <name>          Integrator: path (a path at a time, default) or wavefront (waves in stages)\n"
+              << "  --ray-sort <order>       Ray order of the wavefront engine: direction (default), origin or none\n"
+              << "  --queue-size <n>         Paths in flight per thread in the wavefront engine\n"
+              << "  --store <typed|list>     Scene storage: primitive_store (default) or hittable_list + bvh\n"
+              << "  --output <path>          Also write the JSON results to a file\n"
+              << "  --image <prefix>         Write each frame to <prefix><scene>.pfm\n"
+              << "  --reference <prefix>     Report the RMSE of each frame against <prefix><scene>.pfm\n"
+              << "                           (e.g. rt_bench_float against frames written by rt_bench)\n"
+              << "  --denoise                Denoise each frame; reports its time, and its RMSE with --reference\n"
+              << "  --frames <n>             Render each scene as an n-frame sequence in which 1% of the spheres move;\n"
+              << "                           times are per frame, build_seconds covers the static spheres\n"
+              << "  --rebuild-threshold <x>  Rebuild a sequence's moving tree once refits raise its cost x-fold (0 = always)\n"
+              << "  --check <baseline.json>  Fail if rays/s drops more than --tolerance percent below the baseline;\n"
+              << "                           runs the baseline's scenes unless --scenes is given\n"
+              << "  --tolerance <percent>    Allowed throughput drop for --check (default: 50)\n";
+}
+
+
+int main(int argc, char* argv[]) {
+    bench_settings settings;
+    std::vector<std::string> scenes;
+    std::string output_path, baseline_path;
+    std::vector<int> spp_list; // Sample counts of an error-vs-spp sweep.
+    double tolerance = 50;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--scenes" && has_value) scenes = split(argv[++i]);
+        else if (arg == "--quick") { settings.image_width = 160; settings.samples_per_pixel = 8; }
+        else if (arg == "--width" && has_value) settings.image_width = std::atoi(argv[++i]);
+        else if (arg == "--spp" && has_value) settings.samples_per_pixel = std::atoi(argv[++i]);
+        else if (arg == "--depth" && has_value) settings.max_depth = std::atoi(argv[++i]);
+        else if (arg == "--threads" && has_value) settings.thread_count = std::atoi(argv[++i]);
+        else if (arg == "--packets" && has_value) settings.packet_size = std::atoi(argv[++i]);
+        else if (arg == "--sampler" && has_value) {
+            if (!parse_sampler_kind(argv[++i], settings.sampler)) {
+                std::cerr << "Unknown sampler: " << argv[i] << '\n';
+                return 2;
+            }
+        }
+        else if (arg == "--spp-list" && has_value) {
+            for (const auto& item : split(argv[++i])) {
+                spp_list.push_back(std::atoi(item.c_str()));
+            }
+        }
+        else if (arg == "--engine" && has_value) {
+            std::string name = argv[++i];
+            if (name != "path" && name != "wavefront") {
+                std::cerr << "Unknown engine: " << name << '\n';
+                return 2;
+            }
+            settings.engine = (name == "wavefront") ? integrator::wavefront : integrator::path;
+        }
+        else if (arg == "--ray-sort" && has_value) {
+            std::string name = argv[++i];
+            if (name != "direction" && name != "origin" && name != "none") {
+                std::cerr << "Unknown ray order: " << name << '\n';
+                return 2;
+            }
+            settings.sort = (name == "origin") ? ray_sort::origin : (name == "none") ? ray_sort::none : ray_sort::direction;
+        }
+        else if (arg == "--queue-size" && has_value) settings.queue_size = std::atoi(argv[++i]);
+        else if (arg == "--store" && has_value) {
+            std::string name = argv[++i];
+            if (name != "typed" && name != "list") {
+                std::cerr << "Unknown store: " << name << '\n';
+                return 2;
+            }
+            settings.typed_store = name == "typed";
+        }
+        else if (arg == "--output" && has_value) output_path = argv[++i];
+        else if (arg == "--image" && has_value) settings.image_prefix = argv[++i];
+        else if (arg == "--reference" && has_value) settings.reference_prefix = argv[++i];
+        else if (arg == "--denoise") settings.denoise = true;
+        else if (arg == "--frames" && has_value) settings.frames = std::atoi(argv[++i]);
+        else if (arg == "--rebuild-threshold" && has_value) settings.rebuild_threshold = std::atof(argv[++i]);
+        else if (arg == "--check" && has_value) baseline_path = argv[++i];
+        else if (arg == "--tolerance" && has_value) tolerance = std::atof(argv[++i]);
+        else {
+            print_usage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 2;
+        }
+    }
+
+    // Load the baseline: one JSON object per line, keyed by scene name.
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!baseline_path.empty()) {
+        std::ifstream in(baseline_path);
+        if (!in) {
+            std::cerr << "Cannot read baseline " << baseline_path << '\n';
+            return 2;
+        }
+        std::string line, name;
+        double rays_per_second;
+        while (std::getline(in, line)) {
+            if (json_string(line, "scene", name) && json_number(line, "rays_per_second", rays_per_second)) {
+                baseline.emplace_back(name, rays_per_second);
+            }
+        }
+        if (scenes.empty()) {
+            for (const auto& entry : baseline) {
+                scenes.push_back(entry.first);
+            }
+        }
+    }
+    if (scenes.empty()) {
+        scenes = {"demo", "spheres_100", "spheres_1000", "spheres_10000", "spheres_100000", "spheres_1000000"};
+    }
+
+    // Run the scenes (at every sample count of a sweep) and print the results as a JSON array, one
+    // frame per line.
+    if (spp_list.empty()) {
+        spp_list.push_back(settings.samples_per_pixel);
+    }
+    std::vector<bench_result> results;
+    std::ostringstream json;
+    json << "[\n";
+    for (size_t i = 0; i < scenes.size(); i++) {
+        for (size_t k = 0; k < spp_list.size(); k++) {
+            bench_settings frame = settings;
+            frame.samples_per_pixel = spp_list[k];
+            if (spp_list.size() > 1 && !frame.image_prefix.empty()) {
+                frame.image_prefix += std::to_string(spp_list[k]) + "spp_"; // Keep each sample count's frame.
+            }
+            bench_result result;
+            if (!(frame.frames > 0 ? run_sequence(scenes[i], frame, result) : run_scene(scenes[i], frame, result))) {
+                return 2;
+            }
+            results.push_back(result);
+            json << "  " << to_json(result) << (i + 1 < scenes.size() || k + 1 < spp_list.size() ? ",\n" : "\n");
+        }
+    }
+    json << "]\n";
+    std::cout << json.str();
+
+    if (!output_path.empty()) {
+        std::ofstream out(output_path);
+        out << json.str();
+    }
+
+    // Compare against the baseline. A baseline scene the run left out counts as a failure, so the
+    // check cannot pass with nothing compared.
+    bool regressed = false;
+    for (const auto& entry : baseline) {
+        bool ran = std::any_of(results.begin(), results.end(), [&](const bench_result& result) { return result.scene == entry.first; });
+        if (!ran) {
+            std::cerr << "MISSING " << entry.first << ": in the baseline but not in this run\n";
+            regressed = true;
+        }
+    }
+    for (const auto& result : results) {
+        for (const auto& entry : baseline) {
+            if (entry.first != result.scene) {
+                continue;
+            }
+            double floor = entry.second * (1 - tolerance / 100);
+            bool ok = result.rays_per_second >= floor;
+            std::cerr << (ok ? "ok      " : "SLOWER  ") << result.scene << ": " << result.rays_per_second / 1e6
+                      << " Mrays/s (baseline " << entry.second / 1e6 << ", floor " << floor / 1e6 << ")\n";
+            regressed = regressed || !ok;
+        }
+    }
+    return regressed ? 1 : 0;
+}
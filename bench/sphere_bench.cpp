@@ -0,0 +1,84 @@
+/***************************************************************
+* Description: Microbenchmark comparing sphere intersection    *
+*              throughput of hittable_list + sphere against    *
+*              the sphere_set SIMD kernels.                    *
+***************************************************************/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "rt_general.h"
+#include "hittable_list.h"
+#include "sphere.h"
+#include "sphere_set.h"
+
+
+// Trace every ray against a hittable and return the elapsed seconds; checksum collects hit distances.
+double time_rays(const hittable& world, const std::vector<ray>& rays, int repeats, double& checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (int k = 0; k < repeats; k++) {
+        for (const auto& r : rays) {
+            hit_record rec;
+            if (world.hit(r, interval(0.001, infinity), rec)) {
+                checksum += rec.t;
+            }
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+int main(int argc, char* argv[]) {
+    int sphere_count = (argc > 1) ? std::atoi(argv[1]) : 1000; // Spheres per scene.
+    int ray_count = (argc > 2) ? std::atoi(argv[2]) : 10000; // Rays per pass.
+    int repeats = (argc > 3) ? std::atoi(argv[3]) : 5; // Passes over the rays.
+
+    // Build the same random scene both ways.
+    rng gen(1, 0);
+    hittable_list list;
+    std::vector<sphere_set> sets;
+    simd_level levels[] = {simd_level::scalar, simd_level::sse2, simd_level::avx2, simd_level::avx512};
+    for (auto level : levels) {
+        if (level <= detect_simd_level()) {
+            sets.emplace_back(level);
+        }
+    }
+    for (int i = 0; i < sphere_count; i++) {
+        point3 center = vec3::random(gen, -20, 20);
+        double radius = random_double(gen, 0.1, 1.0);
+        list.add(make_shared<sphere>(center, radius));
+        for (auto& set : sets) {
+            set.add(center, radius);
+        }
+    }
+
+    std::vector<ray> rays;
+    for (int i = 0; i < ray_count; i++) {
+        rays.emplace_back(vec3::random(gen, -25, 25), vec3::random(gen, -1, 1));
+    }
+
+    double tests = double(sphere_count) * ray_count * repeats; // Ray-sphere tests per run.
+    std::cout << "spheres " << sphere_count << ", rays " << ray_count << ", repeats " << repeats << "\n";
+
+    double reference = 0;
+    double seconds = time_rays(list, rays, repeats, reference);
+    std::cout << std::left << std::setw(24) << "hittable_list+sphere" << tests / seconds / 1e6 << " M sphere tests/s\n";
+
+    // The kernels compute in double. A float build's sphere::hit rounds differently, so there the
+    // kernels are checked against the scalar kernel (the first set) instead.
+    bool check_against_list = sizeof(real) == sizeof(double);
+    for (const auto& set : sets) {
+        double checksum = 0;
+        seconds = time_rays(set, rays, repeats, checksum);
+        if (!check_against_list && &set == &sets.front()) {
+            reference = checksum;
+        }
+        std::cout << std::setw(24) << (std::string("sphere_set ") + simd_level_name(set.get_simd_level())) << tests / seconds / 1e6 << " M sphere tests/s"
+                  << (checksum == reference ? "" : "  (MISMATCH)") << "\n";
+        if (checksum != reference) {
+            return 1; // Kernels must find exactly the same hits as the reference path.
+        }
+    }
+}
@@ -0,0 +1,681 @@
+/***************************************************************
+* Description: Header file for the BVH class, a bounding       *
+*              volume hierarchy that replaces the linear scan  *
+*              of a hittable_list with a tree traversal.       *
+***************************************************************/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "thread_pool.h"
+#include "stats.h"
+#include "simd.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// Deepest level a BVH node may sit at (the root is level 0). Traversal keeps its pending nodes in
+// a fixed stack of this many entries, and the builder keeps every tree within it.
+constexpr int bvh_max_depth = 64;
+
+// One node of a flattened BVH. Nodes are stored depth-first in a single array: the first child of
+// an interior node sits right after it, so only the second child's index is stored. Each node is
+// padded to one cache line.
+struct alignas(64) bvh_node {
+    double bounds_min[3]; // Lower corner of the node's bounding box.
+    double bounds_max[3]; // Upper corner of the node's bounding box.
+    int offset; // Leaves: index of the first primitive. Interior nodes: index of the second child.
+    int count; // Number of primitives in a leaf (0 for interior nodes).
+    int axis; // Split axis of an interior node, used for front-to-back traversal.
+};
+
+// Box of a node, and setting a node's box.
+inline aabb bvh_node_bounds(const bvh_node& node) {
+    return aabb(interval(node.bounds_min[0], node.bounds_max[0]), interval(node.bounds_min[1], node.bounds_max[1]),
+                interval(node.bounds_min[2], node.bounds_max[2]));
+}
+
+inline void set_bvh_node_bounds(bvh_node& node, const aabb& box) {
+    for (int a = 0; a < 3; a++) {
+        node.bounds_min[a] = box.axis_interval(a).min;
+        node.bounds_max[a] = box.axis_interval(a).max;
+    }
+}
+
+// Expected cost of tracing a ray through a flattened tree by the builder's surface area heuristic:
+// one unit per node box and per leaf primitive tested, each weighted by the chance that a ray
+// through the root's box also passes through the node's (the ratio of their areas).
+inline double bvh_sah_cost(const std::vector<bvh_node>& nodes) {
+    if (nodes.empty()) {
+        return 0;
+    }
+    double root_area = bvh_node_bounds(nodes[0]).surface_area();
+    if (root_area <= 0) {
+        return 1;
+    }
+    double cost = 0;
+    for (const auto& node : nodes) {
+        cost += bvh_node_bounds(node).surface_area() * (1 + node.count);
+    }
+    return cost / root_area;
+}
+
+// Build settings for the SAH builder.
+struct bvh_build_options {
+    int max_leaf_size = 4; // Leaves never hold more primitives than this.
+    int sah_bins = 16; // Number of buckets used to evaluate split candidates.
+    int parallel_threshold = 16384; // Subtrees at least this large are built on separate threads.
+    int max_sah_depth = 48; // Past this depth, splits fall back to the median to bound tree height
+                            // (lowered for large inputs so the tree stays within bvh_max_depth).
+    int thread_count = 0; // Build threads (0 = all hardware threads).
+};
+
+// Builder producing a flattened BVH from a list of primitive boxes with a binned SAH. The
+// primitive order is rearranged so every leaf references a contiguous range of primitives.
+class bvh_builder {
+public:
+    bvh_builder(const std::vector<aabb>& boxes, const bvh_build_options& options = bvh_build_options())
+      : boxes(boxes), options(options) {
+        centroids.reserve(boxes.size());
+        for (const auto& box : boxes) {
+            centroids.push_back(box.centroid()); // Split decisions are made on box centers.
+        }
+    }
+
+    // Build the tree. On return, order[k] is the original index of the k-th primitive in leaf order.
+    std::vector<bvh_node> build(std::vector<int>& order) {
+        order.resize(boxes.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = int(i);
+        }
+
+        std::vector<bvh_node> nodes;
+        if (order.empty()) {
+            return nodes; // Empty scene: no nodes at all.
+        }
+        nodes.reserve(2 * order.size() / std::max(1, options.max_leaf_size) + 1);
+
+        // Median splits below the SAH depth halve the range until it fits a leaf, which takes at
+        // most ceil(log2(n / max_leaf_size)) more levels; leave room for them under bvh_max_depth.
+        double leaves = double(order.size()) / std::max(1, options.max_leaf_size);
+        int median_levels = leaves > 1 ? int(std::ceil(std::log2(leaves))) : 0;
+        sah_depth = std::max(0, std::min(options.max_sah_depth, bvh_max_depth - 1 - median_levels));
+
+        if (int(order.size()) >= options.parallel_threshold) {
+            thread_pool pool(options.thread_count); // Large input: spread subtrees across threads.
+            build_into(nodes, order, 0, int(order.size()), 0, &pool);
+        }
+        else {
+            build_into(nodes, order, 0, int(order.size()), 0, nullptr);
+        }
+        return nodes;
+    }
+
+private:
+    const std::vector<aabb>& boxes; // Bounding box of every primitive.
+    std::vector<point3> centroids; // Center of every primitive box.
+    bvh_build_options options; // Build settings.
+    int sah_depth = 0; // Depth from which splits are median splits (max_sah_depth, capped by build()).
+
+    // Append the subtree over order[begin, end) to nodes. Subtrees built in parallel go to their
+    // own arrays and are spliced in afterwards, so the layout does not depend on the thread count.
+    void build_into(std::vector<bvh_node>& nodes, std::vector<int>& order, int begin, int end, int depth, thread_pool* pool) const {
+        aabb bounds, centroid_bounds;
+        for (int i = begin; i < end; i++) {
+            bounds = aabb(bounds, boxes[order[i]]); // Box enclosing every primitive.
+            centroid_bounds = aabb(centroid_bounds, aabb(centroids[order[i]], centroids[order[i]]));
+        }
+
+        assert(depth < bvh_max_depth); // Guaranteed by the SAH depth cap in build().
+        int index = int(nodes.size());
+        nodes.push_back(make_node(bounds));
+        int count = end - begin;
+
+        int axis = centroid_bounds.longest_axis(); // Split along the widest spread of centers.
+        int mid = begin;
+        if (depth >= sah_depth) {
+            if (count > options.max_leaf_size) {
+                mid = median_split(order, begin, end, axis); // Deep branch: keep the rest balanced.
+            }
+        }
+        else if (count > 1) {
+            mid = find_split(order, begin, end, bounds, centroid_bounds, axis);
+        }
+
+        if (mid == begin) {
+            nodes[index].offset = begin; // Turn the node into a leaf.
+            nodes[index].count = count;
+            return;
+        }
+
+        nodes[index].axis = axis;
+        if (pool && count >= options.parallel_threshold) {
+            std::vector<bvh_node> second; // Second subtree, built concurrently on another thread.
+            task_group group(*pool);
+            group.run([&] { build_into(second, order, mid, end, depth + 1, pool); });
+            build_into(nodes, order, begin, mid, depth + 1, pool);
+            group.wait();
+
+            int base = int(nodes.size());
+            for (auto node : second) {
+                if (node.count == 0) {
+                    node.offset += base; // Relocate second-child links into the shared array.
+                }
+                nodes.push_back(node);
+            }
+            nodes[index].offset = base;
+        }
+        else {
+            build_into(nodes, order, begin, mid, depth + 1, pool);
+            nodes[index].offset = int(nodes.size());
+            build_into(nodes, order, mid, end, depth + 1, pool);
+        }
+    }
+
+    // Pick a split of order[begin, end) with the surface area heuristic and partition the range.
+    // Returns the first index of the second half, or begin when the range should stay a leaf.
+    int find_split(std::vector<int>& order, int begin, int end, const aabb& bounds, const aabb& centroid_bounds, int axis) const {
+        int count = end - begin;
+        const interval& extent = centroid_bounds.axis_interval(axis);
+
+        if (extent.size() <= 0) {
+            if (count <= options.max_leaf_size) {
+                return begin; // All centers coincide and the leaf is small enough.
+            }
+            return begin + count / 2; // Coincident centers: split the range in the middle.
+        }
+
+        // Drop every primitive into a bucket by its center.
+        int bin_count = std::max(2, options.sah_bins);
+        double scale = bin_count / extent.size();
+        auto bin_of = [&](int prim) {
+            int b = int((centroids[prim][axis] - extent.min) * scale);
+            return std::min(b, bin_count - 1);
+        };
+
+        std::vector<aabb> bin_bounds(bin_count);
+        std::vector<int> bin_counts(bin_count, 0);
+        for (int i = begin; i < end; i++) {
+            int b = bin_of(order[i]);
+            bin_counts[b]++;
+            bin_bounds[b] = aabb(bin_bounds[b], boxes[order[i]]);
+        }
+
+        // Sweep from the right to get the cost of everything after each split plane.
+        std::vector<double> right_cost(bin_count, 0);
+        aabb right_box;
+        int right_count = 0;
+        for (int b = bin_count - 1; b > 0; b--) {
+            right_box = aabb(right_box, bin_bounds[b]);
+            right_count += bin_counts[b];
+            right_cost[b] = right_count * right_box.surface_area();
+        }
+
+        // Sweep from the left and keep the cheapest plane.
+        double best_cost = infinity;
+        int best_bin = -1;
+        aabb left_box;
+        int left_count = 0;
+        for (int b = 0; b < bin_count - 1; b++) {
+            left_box = aabb(left_box, bin_bounds[b]);
+            left_count += bin_counts[b];
+            if (left_count == 0 || left_count == count) {
+                continue; // Not a real split.
+            }
+            double cost = left_count * left_box.surface_area() + right_cost[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_bin = b;
+            }
+        }
+
+        // Traversal cost is taken as one primitive test; compare against keeping a leaf.
+        double area = bounds.surface_area();
+        double split_cost = 1 + ((area > 0) ? best_cost / area : 0);
+        if (count <= options.max_leaf_size && (best_bin < 0 || split_cost >= count)) {
+            return begin;
+        }
+
+        if (best_bin < 0) {
+            return begin + count / 2; // No usable plane: split the range in the middle.
+        }
+
+        auto it = std::partition(order.begin() + begin, order.begin() + end,
+                                 [&](int prim) { return bin_of(prim) <= best_bin; });
+        return int(it - order.begin());
+    }
+
+    // Split order[begin, end) at the median center along axis.
+    int median_split(std::vector<int>& order, int begin, int end, int axis) const {
+        int mid = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+        return mid;
+    }
+
+    static bvh_node make_node(const aabb& box) {
+        bvh_node node;
+        set_bvh_node_bounds(node, box);
+        node.offset = 0;
+        node.count = 0;
+        node.axis = 0;
+        return node;
+    }
+};
+
+// Check whether a ray enters a node's box within [t_min, t_max]; inv_dir holds 1 / direction.
+// Node tests run in double whatever the build's precision, like the node bounds.
+inline bool bvh_node_hit(const bvh_node& node, const double* orig, const double* inv_dir, double t_min, double t_max) {
+    for (int a = 0; a < 3; a++) {
+        double t0 = (node.bounds_min[a] - orig[a]) * inv_dir[a]; // Entry and exit distances for this slab.
+        double t1 = (node.bounds_max[a] - orig[a]) * inv_dir[a];
+        if (inv_dir[a] < 0) {
+            std::swap(t0, t1);
+        }
+        t_min = (t0 > t_min) ? t0 : t_min;
+        t_max = (t1 < t_max) ? t1 : t_max;
+        if (t_max < t_min) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Walk a flattened BVH front to back. leaf_hit(first, count, ray_t) tests a leaf's primitives and
+// returns whether any was hit, shrinking ray_t.max to the closest hit so far. With
+// stop_at_first_hit the walk ends at the first leaf reporting a hit (occlusion queries).
+template <bool stop_at_first_hit = false, typename LeafHit>
+bool bvh_traverse(const bvh_node* nodes, int node_count, const ray& r, interval ray_t, LeafHit&& leaf_hit) {
+    if (node_count == 0) {
+        return false;
+    }
+
+    const vec3& dir = r.direction();
+    double orig[3] = {r.origin()[0], r.origin()[1], r.origin()[2]};
+    double inv_dir[3] = {1.0 / dir[0], 1.0 / dir[1], 1.0 / dir[2]};
+    bool dir_is_neg[3] = {inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0};
+
+    int stack[bvh_max_depth]; // Nodes still to visit: at most one per level above the current node.
+    int stack_size = 0;
+    int current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+        const bvh_node& node = nodes[current];
+        RT_STAT_ADD(node_tests, 1);
+        if (bvh_node_hit(node, orig, inv_dir, ray_t.min, ray_t.max)) {
+            if (node.count > 0) {
+                RT_STAT_ADD(primitive_tests, node.count);
+                if (leaf_hit(node.offset, node.count, ray_t)) {
+                    hit_anything = true;
+                    if (stop_at_first_hit) {
+                        return true;
+                    }
+                }
+            }
+            else {
+                // Visit the child on the ray's side of the split first, so hits shrink ray_t early.
+                if (dir_is_neg[node.axis]) {
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                }
+                else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+
+    return hit_anything;
+}
+
+// Number of rays set in a packet mask.
+inline int packet_lane_count(uint64_t mask) {
+    int n = 0;
+    for (; mask; n++) {
+        mask &= mask - 1; // Clear the lowest set bit.
+    }
+    return n;
+}
+
+// Index of the lowest ray set in a non-empty packet mask.
+inline int packet_first_lane(uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#else
+    int k = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        k++;
+    }
+    return k;
+#endif
+}
+
+// A packet of rays stored lane by lane (SoA) for the packet node kernels. Lanes past count up to
+// the next multiple of 4 repeat ray 0, so the kernels can always work on whole SIMD vectors.
+struct bvh_packet {
+    alignas(64) double orig[3][max_packet_size]; // Ray origins, one array per axis.
+    alignas(64) double inv_dir[3][max_packet_size]; // 1 / direction, one array per axis.
+    alignas(64) double t_max[max_packet_size]; // Closest hit of each ray so far.
+    int count; // Number of rays.
+
+    bvh_packet(const ray* rays, int count, double t_max_start) : count(count) {
+        int padded = (count + 3) & ~3;
+        for (int k = 0; k < padded; k++) {
+            const ray& r = rays[k < count ? k : 0];
+            for (int a = 0; a < 3; a++) {
+                orig[a][k] = r.origin()[a];
+                inv_dir[a][k] = 1.0 / r.direction()[a];
+            }
+            t_max[k] = t_max_start;
+        }
+    }
+};
+
+// Packet node kernels: test a node's box against the rays in lanes [begin, end) and return the
+// mask of rays entering it. begin and end are multiples of 4. Every kernel computes exactly what
+// bvh_node_hit computes for each ray (max/min instructions pick the same operand on NaN as its
+// comparisons), so packets never visit a node a single ray would skip or the other way round.
+inline uint64_t bvh_packet_node_scalar(const bvh_node& node, const bvh_packet& p, double t_min, int begin, int end) {
+    uint64_t mask = 0;
+    for (int k = begin; k < end; k++) {
+        double o[3] = {p.orig[0][k], p.orig[1][k], p.orig[2][k]};
+        double inv[3] = {p.inv_dir[0][k], p.inv_dir[1][k], p.inv_dir[2][k]};
+        if (bvh_node_hit(node, o, inv, t_min, p.t_max[k])) {
+            mask |= uint64_t(1) << k;
+        }
+    }
+    return mask;
+}
+
+#ifdef RT_SIMD_X86
+
+// SSE2 kernel: 2 rays per step.
+__attribute__((target("sse2"))) inline uint64_t bvh_packet_node_sse2(const bvh_node& node, const bvh_packet& p, double t_min, int begin, int end) {
+    uint64_t mask = 0;
+    for (int k = begin; k < end; k += 2) {
+        __m128d lo = _mm_set1_pd(t_min);
+        __m128d hi = _mm_load_pd(p.t_max + k);
+        for (int a = 0; a < 3; a++) {
+            __m128d o = _mm_load_pd(p.orig[a] + k);
+            __m128d inv = _mm_load_pd(p.inv_dir[a] + k);
+            __m128d t0 = _mm_mul_pd(_mm_sub_pd(_mm_set1_pd(node.bounds_min[a]), o), inv);
+            __m128d t1 = _mm_mul_pd(_mm_sub_pd(_mm_set1_pd(node.bounds_max[a]), o), inv);
+            __m128d neg = _mm_cmplt_pd(inv, _mm_setzero_pd());
+            __m128d t_near = _mm_or_pd(_mm_and_pd(neg, t1), _mm_andnot_pd(neg, t0));
+            __m128d t_far = _mm_or_pd(_mm_and_pd(neg, t0), _mm_andnot_pd(neg, t1));
+            lo = _mm_max_pd(t_near, lo); // (t_near > lo) ? t_near : lo
+            hi = _mm_min_pd(t_far, hi); // (t_far < hi) ? t_far : hi
+        }
+        mask |= uint64_t(_mm_movemask_pd(_mm_cmpge_pd(hi, lo))) << k;
+    }
+    return mask;
+}
+
+// AVX2 kernel: 4 rays per step.
+__attribute__((target("avx2"))) inline uint64_t bvh_packet_node_avx2(const bvh_node& node, const bvh_packet& p, double t_min, int begin, int end) {
+    uint64_t mask = 0;
+    for (int k = begin; k < end; k += 4) {
+        __m256d lo = _mm256_set1_pd(t_min);
+        __m256d hi = _mm256_load_pd(p.t_max + k);
+        for (int a = 0; a < 3; a++) {
+            __m256d o = _mm256_load_pd(p.orig[a] + k);
+            __m256d inv = _mm256_load_pd(p.inv_dir[a] + k);
+            __m256d t0 = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(node.bounds_min[a]), o), inv);
+            __m256d t1 = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(node.bounds_max[a]), o), inv);
+            __m256d neg = _mm256_cmp_pd(inv, _mm256_setzero_pd(), _CMP_LT_OQ);
+            lo = _mm256_max_pd(_mm256_blendv_pd(t0, t1, neg), lo);
+            hi = _mm256_min_pd(_mm256_blendv_pd(t1, t0, neg), hi);
+        }
+        mask |= uint64_t(_mm256_movemask_pd(_mm256_cmp_pd(hi, lo, _CMP_GE_OQ))) << k;
+    }
+    return mask;
+}
+
+#endif // RT_SIMD_X86
+
+constexpr int packet_scalar_lanes = 2; // At or below this many live rays, a packet tests its rays one by one.
+
+// Walk a flattened BVH with a packet of up to max_packet_size rays. Each node's box is tested
+// against all rays that reached it with one kernel call, so node fetches and traversal decisions
+// are shared by the packet; once only a few rays are left in a subtree they are tested one by one.
+// leaf_hit(first, count, k) tests a leaf's primitives for ray k, shrinking p.t_max[k]. Each ray
+// sees the same boxes and hits as in bvh_traverse.
+template <typename LeafHit>
+void bvh_traverse_packet(const bvh_node* nodes, int node_count, bvh_packet& p, double t_min, simd_level kernel,
+                         LeafHit&& leaf_hit) {
+    if (node_count == 0 || p.count <= 0) {
+        return;
+    }
+
+    struct entry {
+        int node; // Node to visit.
+        uint64_t mask; // Rays that entered its parent.
+    };
+    entry stack[bvh_max_depth]; // At most one entry per level above the current node.
+    int stack_size = 0;
+    entry current = {0, p.count == 64 ? ~uint64_t(0) : (uint64_t(1) << p.count) - 1};
+
+    while (true) {
+        const bvh_node& node = nodes[current.node];
+        uint64_t mask = 0; // Rays that enter this node.
+        int live = packet_lane_count(current.mask);
+        RT_STAT_ADD(node_tests, live);
+
+        if (live <= packet_scalar_lanes) {
+            for (uint64_t m = current.mask; m; m &= m - 1) {
+                int k = packet_first_lane(m);
+                mask |= bvh_packet_node_scalar(node, p, t_min, k, k + 1);
+            }
+        }
+        else {
+            // Only the span of vectors holding live rays is tested.
+            int begin = packet_first_lane(current.mask) & ~3;
+            int end = 64;
+            while (!(current.mask >> (end - 1) & 1)) {
+                end--;
+            }
+            end = (end + 3) & ~3;
+            switch (kernel) {
+#ifdef RT_SIMD_X86
+                case simd_level::avx512:
+                case simd_level::avx2: mask = bvh_packet_node_avx2(node, p, t_min, begin, end); break;
+                case simd_level::sse2: mask = bvh_packet_node_sse2(node, p, t_min, begin, end); break;
+#endif
+                default: mask = bvh_packet_node_scalar(node, p, t_min, begin, end); break;
+            }
+            mask &= current.mask;
+        }
+
+        if (mask) {
+            if (node.count > 0) {
+                for (uint64_t m = mask; m; m &= m - 1) {
+                    RT_STAT_ADD(primitive_tests, node.count);
+                    leaf_hit(node.offset, node.count, packet_first_lane(m));
+                }
+            }
+            else {
+                // Visit the child on the side of the first live ray first; rays in a packet mostly agree.
+                if (p.inv_dir[node.axis][packet_first_lane(mask)] < 0) {
+                    stack[stack_size++] = {current.node + 1, mask};
+                    current = {node.offset, mask};
+                }
+                else {
+                    stack[stack_size++] = {node.offset, mask};
+                    current = {current.node + 1, mask};
+                }
+                continue;
+            }
+        }
+        if (stack_size == 0) {
+            break;
+        }
+        current = stack[--stack_size];
+    }
+}
+
+// How a BVH reaches its primitives. Concrete types stored by value are called directly (a
+// qualified call, so no vtable lookup and the test can inline into the traversal loop); pointers
+// to hittables keep the virtual call, so any hittable can still go into a BVH.
+template <typename Primitive>
+struct bvh_primitive {
+    static bool hit(const Primitive& p, const ray& r, interval t, hit_record& rec) { return p.Primitive::hit(r, t, rec); }
+    static bool any_hit(const Primitive& p, const ray& r, interval t) { return p.Primitive::any_hit(r, t); }
+    static aabb bounding_box(const Primitive& p) { return p.Primitive::bounding_box(); }
+};
+
+template <typename T>
+struct bvh_primitive<shared_ptr<T>> {
+    static bool hit(const shared_ptr<T>& p, const ray& r, interval t, hit_record& rec) { return p->hit(r, t, rec); }
+    static bool any_hit(const shared_ptr<T>& p, const ray& r, interval t) { return p->any_hit(r, t); }
+    static aabb bounding_box(const shared_ptr<T>& p) { return p->bounding_box(); }
+};
+
+// Class template representing a BVH over primitives of type Primitive, stored contiguously in
+// leaf order. bvh (over shared_ptr<hittable>) takes any mix of objects; basic_bvh<sphere> and the
+// like hold one concrete type by value.
+template <typename Primitive>
+class basic_bvh : public hittable {
+public:
+    // Constructors:
+    basic_bvh() {} // Empty tree.
+
+    basic_bvh(std::vector<Primitive> primitives, const bvh_build_options& options = bvh_build_options()) {
+        std::vector<aabb> boxes;
+        boxes.reserve(primitives.size());
+        for (const auto& primitive : primitives) {
+            boxes.push_back(bvh_primitive<Primitive>::bounding_box(primitive));
+            bbox = aabb(bbox, boxes.back());
+        }
+
+        std::vector<int> order;
+        nodes = bvh_builder(boxes, options).build(order);
+
+        objects.reserve(order.size());
+        for (int index : order) {
+            objects.push_back(std::move(primitives[index])); // Store primitives in leaf order.
+        }
+        sources = std::move(order);
+        built_cost = bvh_sah_cost(nodes);
+    }
+
+    basic_bvh(const hittable_list& list, const bvh_build_options& options = bvh_build_options())
+        : basic_bvh(list.objects, options) {}
+
+    // Method to check for ray-object intersection with the objects in the BVH.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        return bvh_traverse(nodes.data(), int(nodes.size()), r, ray_t, [&](int first, int count, interval& t) {
+            hit_record temp_rec; // Temporary hit record.
+            bool hit_anything = false;
+            for (int i = first; i < first + count; i++) {
+                if (bvh_primitive<Primitive>::hit(objects[i], r, t, temp_rec)) {
+                    hit_anything = true;
+                    t.max = temp_rec.t; // Only closer hits count from now on.
+                    rec = temp_rec;
+                }
+            }
+            return hit_anything;
+        });
+    }
+
+    // Method to trace a packet of rays together, sharing node tests across the packet.
+    void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        bvh_packet p(rays, count, ray_t.max);
+        for (int k = 0; k < count; k++) {
+            hits[k] = false;
+        }
+        bvh_traverse_packet(nodes.data(), int(nodes.size()), p, ray_t.min, kernel, [&](int first, int n, int k) {
+            hit_record temp_rec; // Temporary hit record.
+            for (int i = first; i < first + n; i++) {
+                if (bvh_primitive<Primitive>::hit(objects[i], rays[k], interval(ray_t.min, p.t_max[k]), temp_rec)) {
+                    hits[k] = true;
+                    p.t_max[k] = temp_rec.t; // Only closer hits count from now on.
+                    recs[k] = temp_rec;
+                }
+            }
+        });
+    }
+
+    // Method to check whether the ray hits any object, stopping at the first one found.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        return bvh_traverse<true>(nodes.data(), int(nodes.size()), r, ray_t, [&](int first, int count, interval& t) {
+            for (int i = first; i < first + count; i++) {
+                if (bvh_primitive<Primitive>::any_hit(objects[i], r, t)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    // Method returning the bounding box of the whole hierarchy.
+    aabb bounding_box() const override { return bbox; }
+
+    // Move primitives in place and refit the tree around them. update(primitive, index) is called
+    // for every primitive, with its index in the vector the tree was built from; the node boxes are
+    // then recomputed bottom-up. The tree keeps its shape, so it stays correct however far the
+    // primitives move, but slows down as they leave the places it was built for: cost_growth()
+    // tells when building a new tree would pay off.
+    template <typename Update>
+    void refit(Update&& update) {
+        for (size_t i = 0; i < objects.size(); i++) {
+            update(objects[i], sources[i]);
+        }
+        // Both children of a node come after it in the depth-first layout, so a backward sweep
+        // refits them before their parent.
+        for (int i = int(nodes.size()) - 1; i >= 0; i--) {
+            bvh_node& node = nodes[i];
+            aabb box;
+            if (node.count > 0) {
+                for (int k = node.offset; k < node.offset + node.count; k++) {
+                    box = aabb(box, bvh_primitive<Primitive>::bounding_box(objects[k]));
+                }
+            }
+            else {
+                box = aabb(bvh_node_bounds(nodes[i + 1]), bvh_node_bounds(nodes[node.offset]));
+            }
+            set_bvh_node_bounds(node, box);
+        }
+        bbox = nodes.empty() ? aabb() : bvh_node_bounds(nodes[0]);
+    }
+
+    // SAH cost of the tree now relative to right after its build (1 = as good as new).
+    double cost_growth() const {
+        return (built_cost > 0) ? bvh_sah_cost(nodes) / built_cost : 1;
+    }
+
+    // Number of nodes in the flattened tree.
+    size_t node_count() const { return nodes.size(); }
+
+    // The primitives, in leaf order.
+    const std::vector<Primitive>& primitives() const { return objects; }
+
+private:
+    std::vector<bvh_node> nodes; // Flattened tree, root first.
+    std::vector<Primitive> objects; // Primitives in leaf order.
+    std::vector<int> sources; // Index of each primitive in the vector the tree was built from.
+    double built_cost = 0; // SAH cost of the tree as built.
+    aabb bbox; // Bounding box of all objects.
+    simd_level kernel = detect_simd_level(); // Packet node kernel.
+};
+
+// BVH over any hittables, reached through shared pointers.
+using bvh = basic_bvh<shared_ptr<hittable>>;
+
+#endif // BVH_H
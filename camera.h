@@ -8,38 +8,209 @@
 
 #include "rt_general.h" // Include necessary header files.
 #include "hittable.h"
+#include "thread_pool.h"
+#include "framebuffer.h"
+#include "accumulation.h"
+#include "aov.h"
+#include "wavefront.h"
+#include "sampler.h"
+#include "image_writer.h"
+#include "stats.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Part of a frame: a range of tiles (numbered row by row) and a range of sample indices. Every
+// sample draws from the stream of its (seed, pixel, sample index), so a frame rendered in parts
+// takes exactly the samples a whole render would.
+struct render_range {
+    int tile_begin = 0; // First tile.
+    int tile_end = -1; // One past the last tile (-1 = through the last tile).
+    int sample_begin = 0; // First sample index taken in every pixel.
+    int sample_end = -1; // One past the last sample index (-1 = samples_per_pixel).
+};
+
+// How the camera traces paths.
+enum class integrator {
+    path, // One path at a time, from the camera ray to its end.
+    wavefront // Waves of paths, advanced one stage at a time over the whole wave.
+};
 
 // Class representing a camera for ray tracing.
 class camera {
 public:
     double aspect_ratio = 1.0; // Aspect ratio of the camera.
     int image_width = 100; // Width of the rendered image.
-    int samples_per_pixel; // Number of random samples per pixel.
+    int samples_per_pixel; // Number of random samples per pixel (the cap in adaptive mode).
     int max_depth = 10; // Maximum number of ray bounces.
 
-    // Method to render the scene.
+    double vfov = 90; // Vertical field of view in degrees.
+    point3 lookfrom = point3(0, 0, 0); // Camera position.
+    point3 lookat = point3(0, 0, -1); // Point the camera looks at; its distance is the focal length.
+    vec3 vup = vec3(0, 1, 0); // Direction that is "up" in the image.
+
+    int thread_count = 0; // Number of render threads (0 = use every hardware thread).
+    thread_pool* pool = nullptr; // Pool to render on, shared with other work (nullptr = a pool of thread_count threads per render).
+    int tile_size = 16; // Edge length in pixels of the square tiles handed out to threads.
+    uint64_t seed = 0; // Frame seed; samples draw from streams keyed on (seed, pixel, sample).
+    sampler_kind sampler = sampler_kind::independent; // How samples choose their pixel positions and bounce directions.
+
+    bool adaptive_sampling = false; // Stop sampling a pixel once its noise estimate is low enough.
+    double noise_threshold = 0.005; // Standard error of the pixel's mean luminance at which it has converged.
+    int min_samples = 16; // Samples every pixel takes before it may stop early.
+
+    int packet_size = 0; // Edge of the pixel blocks whose primary rays are traced as one packet (4 or 8; 0 = off).
+
+    integrator engine = integrator::path; // How paths are traced; both give the same image.
+    wavefront_options wavefront; // Queue size and ray order of the wavefront engine.
+
+    bool russian_roulette = true; // Randomly end low-contribution paths (unbiased).
+    int rr_min_depth = 3; // Bounces every path takes before Russian roulette may end it.
+
+    bool record_aovs = false; // Also fill aovs() with albedo, normal, depth and noise buffers (e.g. for denoising).
+
+    bool show_progress = true; // Print the tiles remaining to standard error.
+
+    const std::atomic<bool>* cancel = nullptr; // Once set, tiles not yet started are skipped and render returns (nullptr = never).
+    std::function<void(int x0, int y0, int x1, int y1)> on_tile; // Called as each tile's pixels are stored, from the thread that rendered it.
+
+    // Method to render the scene and write it to standard output as a plain-text PPM.
     void render(const hittable& world) {
+        framebuffer image;
+        render(world, image);
+        write_file("-", encode_ppm_ascii(image)); // Emit the finished image in one go.
+    }
+
+    // Method to render the scene into a framebuffer of linear radiance.
+    void render(const hittable& world, framebuffer& image) {
+        accumulation_buffer sums;
+        render(world, render_range(), sums);
+        sums.resolve(image);
+    }
+
+    // Method to render part of the frame: the samples of range in the tiles of range. The sample
+    // sums and counts of its pixels go to sums, which is resized to the frame and cleared first.
+    // Tiles finish in any order, and on_tile may be called for several at once; the pixels of a
+    // tile it is called for are final. Setting *cancel ends the render early, after the tiles
+    // being rendered (interrupted() tells); a render always starts afresh, so the camera can
+    // render again right away, e.g. with new settings. One camera renders one frame at a time:
+    // render copies of it to run renders side by side.
+    void render(const hittable& world, const render_range& range, accumulation_buffer& sums) {
         initialize(); // Initialize camera parameters.
+        sums.resize(image_width, image_height); // Shared output pixels.
+        sample_counts.assign(size_t(image_width) * image_height, 0);
+        aov_output.resize(record_aovs ? image_width : 0, record_aovs ? image_height : 0);
+        pixel_costs.assign(stats_enabled ? size_t(image_width) * image_height : 0, 0);
+        total_rays = 0;
+        total_paths = 0;
+        reset_stats();
+        auto start = std::chrono::steady_clock::now();
 
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n"; // PPM image header.
+        tiles_x = frame_tiles_x(); // Tiles per row.
+        int tile_count = tiles_x * frame_tiles_y();
+        tile_times.assign(tile_count, 0);
+        int tile_begin = std::min(std::max(range.tile_begin, 0), tile_count);
+        int tile_end = (range.tile_end < 0) ? tile_count : std::min(std::max(range.tile_end, tile_begin), tile_count);
+        first_sample = std::max(range.sample_begin, 0);
+        int last_sample = (range.sample_end < 0) ? samples_per_pixel : std::min(range.sample_end, samples_per_pixel);
+        sample_budget = std::max(last_sample - first_sample, 0);
 
-        // Loop over each pixel row.
-        for (int j = 0; j < image_height; j++) {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush; // Output progress.
-            // Loop over each pixel column.
-            for (int i = 0; i < image_width; i++) {
-                color pixel_color(0, 0, 0); // Initialize pixel color.
-                // Sample multiple rays per pixel and accumulate colors.
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    ray r = get_ray(i, j); // Get ray for current pixel and sample.
-                    pixel_color += ray_color(r, max_depth, world); // Accumulate color.
-                }
-                write_color(std::cout, pixel_samples_scale * pixel_color); // Write color to output stream.
+        std::atomic<int> tiles_done{0}; // Finished tiles, for progress output and interruptions.
+        std::mutex progress_mutex; // Keeps progress lines from interleaving.
+
+        // Render all tiles in parallel; idle threads steal tiles from busy ones. An own pool is
+        // scoped so its threads have handed over their counters before they are collected.
+        {
+            std::unique_ptr<thread_pool> own_pool;
+            if (!pool) {
+                own_pool = std::make_unique<thread_pool>(thread_count);
             }
+            thread_pool& workers = pool ? *pool : *own_pool;
+            workers.parallel_for(tile_begin, tile_end, [&](int tile) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) {
+                    return; // Cancelled: leave the remaining tiles empty.
+                }
+                int x0 = (tile % tiles_x) * tile_size; // Left edge of the tile.
+                int y0 = (tile / tiles_x) * tile_size; // Top edge of the tile.
+                uint64_t rays = 0, paths = 0; // Counted per tile and merged once, off the hot path.
+                auto tile_start = std::chrono::steady_clock::now();
+                render_tile(world, x0, y0, sums, rays, paths);
+                tile_times[tile] = std::chrono::duration<double>(std::chrono::steady_clock::now() - tile_start).count();
+                if (on_tile) {
+                    on_tile(x0, y0, std::min(x0 + tile_size, image_width), std::min(y0 + tile_size, image_height));
+                }
+
+                int remaining = tile_end - tile_begin - ++tiles_done;
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                total_rays += rays;
+                total_paths += paths;
+                if (show_progress) {
+                    std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush; // Output progress.
+                }
+            });
+        }
+
+        render_interrupted = tiles_done < tile_end - tile_begin;
+        counters = pool ? render_counters() : collect_stats(); // A shared pool's threads keep theirs.
+        render_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (show_progress) {
+            std::clog << "\rDone.                 \n"; // Output completion message.
+        }
+    }
+
+    // Auxiliary buffers of the pixels of the last render; empty unless record_aovs is set.
+    const aov_buffers& aovs() const { return aov_output; }
+
+    // Number of samples each pixel of the last render took, row by row from the top.
+    const std::vector<int>& samples_taken() const { return sample_counts; }
+
+    // Statistics of the last render.
+    bool interrupted() const { return render_interrupted; } // Cancelled before every tile was rendered.
+    uint64_t rays_traced() const { return total_rays; }
+    uint64_t paths_traced() const { return total_paths; }
+    double seconds() const { return render_seconds; }
+    double rays_per_second() const { return render_seconds > 0 ? total_rays / render_seconds : 0; }
+    double average_path_length() const { return total_paths > 0 ? double(total_rays) / total_paths : 0; }
+
+    // Hot-path counters of the last render; all zero unless built with RT_ENABLE_STATS, or if the
+    // render ran on a shared pool.
+    const render_counters& stats() const { return counters; }
+
+    // Seconds spent on each tile of the last render, tile by tile and row by row.
+    const std::vector<double>& tile_seconds() const { return tile_times; }
+    int tiles_per_row() const { return tiles_x; }
+
+    // Node plus primitive tests spent on each pixel of the last render, row by row from the top.
+    // Empty unless built with RT_ENABLE_STATS.
+    const std::vector<uint64_t>& pixel_cost() const { return pixel_costs; }
+
+    // Write the statistics of the last render as JSON.
+    void write_stats(std::ostream& out) const {
+        write_stats_json(out, counters, render_seconds, tile_size, tiles_x, tile_times);
+    }
+
+    // Average samples per pixel of the last render.
+    double average_samples() const {
+        double total = 0;
+        for (int n : sample_counts) {
+            total += n;
         }
+        return sample_counts.empty() ? 0 : total / sample_counts.size();
+    }
 
-        std::clog << "\rDone.                 \n"; // Output completion message.
+    // Frame layout for the current settings: the image height and the tile grid.
+    int frame_height() const {
+        int height = int(image_width / aspect_ratio); // Compute image height based on aspect ratio.
+        return (height < 1) ? 1 : height; // Ensure minimum height of 1 pixel.
     }
+    int frame_tiles_x() const { return (image_width + tile_edge() - 1) / tile_edge(); }
+    int frame_tiles_y() const { return (frame_height() + tile_edge() - 1) / tile_edge(); }
 
 private:
     int image_height; // Height of the rendered image.
@@ -47,34 +218,362 @@ private:
     point3 pixel00_loc; // Location of top-left pixel.
     vec3 pixel_delta_u; // Change in pixel position along the x-axis
     vec3 pixel_delta_v; // Change in pixel position along the y-axis.
-    double pixel_samples_scale; // Scale factor for pixel color samples.
+    std::vector<int> sample_counts; // Samples taken per pixel in the last render.
+    uint64_t total_rays = 0; // Rays traced in the last render.
+    uint64_t total_paths = 0; // Camera paths traced in the last render.
+    double render_seconds = 0; // Wall-clock time of the last render.
+    bool render_interrupted = false; // The last render was cancelled before it finished.
+    render_counters counters; // Merged hot-path counters of the last render.
+    std::vector<double> tile_times; // Seconds per tile in the last render.
+    int tiles_x = 0; // Tiles per row in the last render.
+    std::vector<uint64_t> pixel_costs; // Node plus primitive tests per pixel (RT_ENABLE_STATS only).
+    int first_sample = 0; // Sample index the current render starts at.
+    int sample_budget = 0; // Samples the current render takes per pixel (at most).
+    aov_buffers aov_output; // Auxiliary buffers of the last render (record_aovs only).
+
+    // Running state of one pixel while it is being sampled.
+    struct pixel_state {
+        color sum = color(0, 0, 0); // Sum of the samples taken.
+        int n = 0; // Samples taken so far.
+        double mean = 0, m2 = 0; // Running mean and squared deviations of sample luminance (Welford).
+        color albedo_sum = color(0, 0, 0); // Sums of the first hits' auxiliary values (record_aovs only).
+        vec3 normal_sum = vec3(0, 0, 0);
+        double depth_sum = 0;
+        int hits = 0; // Samples whose first ray hit something.
+    };
+
+    // Render the pixels of one tile into the framebuffer, pixel by pixel or in packets.
+    // rays and paths receive the number of rays and camera paths traced.
+    void render_tile(const hittable& world, int x0, int y0, accumulation_buffer& sums, uint64_t& rays, uint64_t& paths) {
+        int x1 = std::min(x0 + tile_size, image_width); // Right edge (exclusive).
+        int y1 = std::min(y0 + tile_size, image_height); // Bottom edge (exclusive).
+
+        if (engine == integrator::wavefront) {
+            render_wavefront(world, x0, y0, x1, y1, sums, rays, paths);
+            return;
+        }
+        if (packet_size > 1) {
+            for (int y = y0; y < y1; y += packet_size) {
+                for (int x = x0; x < x1; x += packet_size) {
+                    render_block(world, x, y, std::min(x + packet_size, x1), std::min(y + packet_size, y1), sums, rays, paths);
+                }
+            }
+            return;
+        }
+
+        for (int j = y0; j < y1; j++) {
+            for (int i = x0; i < x1; i++) {
+#ifdef RT_ENABLE_STATS
+                size_t pixel_index = size_t(j) * image_width + i;
+                const render_counters& mine = thread_counters();
+                uint64_t cost_before = mine.node_tests + mine.primitive_tests;
+#endif
+
+                pixel_state px;
+
+                // Sample rays and accumulate colors until the sample cap, or until the pixel converges.
+                while (px.n < sample_budget) {
+                    pixel_sampler numbers = make_sampler(i, j, first_sample + px.n); // Every sample has its own reproducible numbers.
+                    ray r = get_ray(i, j, numbers); // Get ray for current pixel and sample.
+                    int path_length = 0;
+                    color sample = ray_color(r, world, numbers, path_length, px);
+                    rays += path_length;
+                    if (add_sample(px, sample, path_length)) {
+                        break; // Further samples would barely change this pixel.
+                    }
+                }
+#ifdef RT_ENABLE_STATS
+                pixel_costs[pixel_index] = mine.node_tests + mine.primitive_tests - cost_before;
+#endif
+                store_pixel(i, j, px, sums, paths);
+            }
+        }
+    }
+
+    // Render the block of pixels [x0, x1) x [y0, y1) with packets of primary rays: each round traces
+    // the next sample of every unfinished pixel in the block together, then follows each path's
+    // bounces as single rays, since bounced rays are no longer coherent. Samples use the same
+    // numbers as single-ray rendering, so the image is the same.
+    void render_block(const hittable& world, int x0, int y0, int x1, int y1, accumulation_buffer& sums,
+                      uint64_t& rays, uint64_t& paths) {
+        int width = x1 - x0;
+        int lanes = width * (y1 - y0);
+#ifdef RT_ENABLE_STATS
+        const render_counters& mine = thread_counters();
+        uint64_t cost_before = mine.node_tests + mine.primitive_tests;
+#endif
+
+        pixel_state px[max_packet_size];
+        bool active[max_packet_size]; // Pixels that still take samples.
+        for (int k = 0; k < lanes; k++) {
+            active[k] = sample_budget > 0;
+        }
+
+        pixel_sampler samplers[max_packet_size]; // Sampler of each packet ray's sample.
+        ray primary[max_packet_size];
+        hit_record recs[max_packet_size];
+        bool hits[max_packet_size];
+        int lane_of[max_packet_size]; // Pixel of each packet ray.
+
+        while (true) {
+            int count = 0;
+            for (int k = 0; k < lanes; k++) {
+                if (active[k]) {
+                    int i = x0 + k % width, j = y0 + k / width;
+                    samplers[count] = make_sampler(i, j, first_sample + px[k].n);
+                    primary[count] = get_ray(i, j, samplers[count]);
+                    lane_of[count++] = k;
+                }
+            }
+            if (count == 0) {
+                break;
+            }
+
+            world.hit_packet(primary, count, interval(0, infinity), recs, hits);
+            for (int c = 0; c < count; c++) {
+                if (record_aovs) {
+                    add_first_hit(px[lane_of[c]], primary[c], hits[c], recs[c]);
+                }
+                int path_length = 0;
+                color sample = continue_path(primary[c], hits[c], recs[c], world, samplers[c], path_length);
+                rays += path_length;
+                if (add_sample(px[lane_of[c]], sample, path_length)) {
+                    active[lane_of[c]] = false;
+                }
+            }
+        }
+
+        for (int k = 0; k < lanes; k++) {
+#ifdef RT_ENABLE_STATS
+            pixel_costs[size_t(y0 + k / width) * image_width + x0 + k % width] = (mine.node_tests + mine.primitive_tests - cost_before) / lanes; // Shared evenly by the block.
+#endif
+            store_pixel(x0 + k % width, y0 + k / width, px[k], sums, paths);
+        }
+    }
+
+    // Render the pixels [x0, x1) x [y0, y1) with the wavefront engine. Each wave generates the
+    // paths of the next few samples of every unfinished pixel into a queue, then advances the whole
+    // queue one bounce at a time in stages: extend (trace every ray, in packets if packet_size is
+    // set), shade (absorb, Russian roulette and scatter, or finish the path), and sort the survivors
+    // by ray direction or origin so the next extend walks the BVH coherently. Finished paths leave
+    // their radiance in a slot per pixel sample, which is accumulated in sample order; as every path
+    // carries its own sampler, the image is the one the path integrator renders.
+    void render_wavefront(const hittable& world, int x0, int y0, int x1, int y1, accumulation_buffer& sums,
+                          uint64_t& rays, uint64_t& paths) {
+        int width = x1 - x0;
+        int pixels = width * (y1 - y0);
+#ifdef RT_ENABLE_STATS
+        const render_counters& mine = thread_counters();
+        uint64_t cost_before = mine.node_tests + mine.primitive_tests;
+#endif
+        wavefront_buffers& buffers = thread_wavefront_buffers();
+        path_queue& queue = buffers.queue;
+        std::vector<pixel_state> px(pixels);
+        std::vector<char> active(pixels, sample_budget > 0); // Pixels that still take samples.
+        int active_count = (sample_budget > 0) ? pixels : 0;
+        int taken = 0; // Samples taken by every active pixel so far.
+        aabb bounds = world.bounding_box();
+
+        while (active_count > 0) {
+            // Samples per pixel in this wave. Adaptive pixels may stop after any sample once they
+            // have min_samples, so from then on waves take one sample each.
+            int chunk = sample_budget - taken;
+            if (adaptive_sampling) {
+                chunk = std::min(chunk, std::max(std::max(min_samples, 2) - taken, 1));
+            }
+            chunk = std::max(std::min(chunk, std::max(wavefront.queue_size, 1) / active_count), 1);
+
+            // Generate: one camera ray per active pixel and sample.
+            queue.clear();
+            buffers.results.assign(size_t(pixels) * chunk, color(0, 0, 0));
+            buffers.lengths.assign(size_t(pixels) * chunk, 0);
+            for (int k = 0; k < pixels; k++) {
+                int i = x0 + k % width, j = y0 + k / width;
+                for (int s = 0; active[k] && s < chunk; s++) {
+                    pixel_sampler numbers = make_sampler(i, j, first_sample + taken + s);
+                    ray r = get_ray(i, j, numbers);
+                    if (max_depth > 0) {
+                        queue.push(r, color(1, 1, 1), numbers, uint32_t(k * chunk + s));
+                    }
+                }
+            }
+
+            for (int depth = 0; depth < max_depth && queue.size() > 0; depth++) {
+                // Extend: find the closest hit of every ray.
+                size_t n = queue.size();
+                interval ray_t(depth > 0 ? bounce_t_min : 0, infinity);
+                buffers.recs.resize(n);
+                buffers.hits.resize(n);
+                if (packet_size > 1) {
+                    for (size_t base = 0; base < n; base += max_packet_size) {
+                        int count = int(std::min(n - base, size_t(max_packet_size)));
+                        ray packet[max_packet_size];
+                        bool hit[max_packet_size];
+                        for (int c = 0; c < count; c++) {
+                            packet[c] = queue.ray_at(base + c);
+                        }
+                        world.hit_packet(packet, count, ray_t, &buffers.recs[base], hit);
+                        std::copy(hit, hit + count, buffers.hits.begin() + base);
+                    }
+                }
+                else {
+                    for (size_t p = 0; p < n; p++) {
+                        buffers.hits[p] = world.hit(queue.ray_at(p), ray_t, buffers.recs[p]);
+                    }
+                }
+                if (depth == 0 && record_aovs) {
+                    for (size_t p = 0; p < n; p++) {
+                        add_first_hit(px[queue.slots[p] / chunk], queue.ray_at(p), buffers.hits[p], buffers.recs[p]);
+                    }
+                }
+
+                // Shade: finish paths that escape or die, and scatter the others into the next queue.
+                path_queue& next = buffers.next;
+                next.clear();
+                for (size_t p = 0; p < n; p++) {
+                    uint32_t slot = queue.slots[p];
+                    buffers.lengths[slot] = depth + 1;
+                    color throughput = queue.throughput_at(p);
+                    if (!buffers.hits[p]) {
+                        buffers.results[slot] = throughput * background(queue.ray_at(p)); // The path escapes to the sky.
+                        continue;
+                    }
+                    const hit_record& rec = buffers.recs[p];
+                    throughput = surface_albedo(rec) * throughput;
+                    pixel_sampler numbers = queue.samplers[p];
+                    if (russian_roulette && depth + 1 >= rr_min_depth) {
+                        double survive = std::min(1.0, double(std::max({throughput.x(), throughput.y(), throughput.z()})));
+                        if (numbers.get_1d() >= survive) {
+                            continue;
+                        }
+                        throughput = throughput / survive;
+                    }
+                    vec3 direction = scatter_direction(numbers, rec.normal);
+                    if (depth + 1 < max_depth) {
+                        next.push(ray(rec.p, direction), throughput, numbers, slot);
+                    }
+                }
+
+                // Sort the survivors for the next bounce.
+                if (wavefront.sort != ray_sort::none && next.size() > 1) {
+                    sort_keys(next, wavefront.sort, bounds, buffers.keys);
+                    radix_sort_order(buffers.keys, buffers.order, buffers.scratch);
+                    queue.gather(next, buffers.order);
+                }
+                else {
+                    std::swap(queue, next);
+                }
+            }
+
+            // Accumulate: add each pixel's samples in order.
+            for (int k = 0; k < pixels; k++) {
+                for (int s = 0; active[k] && s < chunk; s++) {
+                    size_t slot = size_t(k) * chunk + s;
+                    rays += buffers.lengths[slot];
+                    if (add_sample(px[k], buffers.results[slot], buffers.lengths[slot])) {
+                        active[k] = false;
+                        active_count--;
+                    }
+                }
+            }
+            taken += chunk;
+        }
+
+        for (int k = 0; k < pixels; k++) {
+#ifdef RT_ENABLE_STATS
+            pixel_costs[size_t(y0 + k / width) * image_width + x0 + k % width] = (mine.node_tests + mine.primitive_tests - cost_before) / pixels; // Shared evenly by the tile.
+#endif
+            store_pixel(x0 + k % width, y0 + k / width, px[k], sums, paths);
+        }
+    }
+
+    // Add a sample to a pixel and report whether the pixel is finished: it reached the sample cap,
+    // or adaptive sampling found it converged.
+    bool add_sample(pixel_state& px, const color& sample, [[maybe_unused]] int path_length) const {
+        RT_STAT_ADD(primary_rays, path_length > 0); // Nothing is traced when max_depth is 0.
+        RT_STAT_ADD(bounce_rays, std::max(path_length - 1, 0));
+        RT_STAT_PATH(path_length);
+
+        px.sum += sample; // Accumulate color.
+        px.n++;
+        if (adaptive_sampling || record_aovs) {
+            double y = luminance(sample);
+            double delta = y - px.mean;
+            px.mean += delta / px.n;
+            px.m2 += delta * (y - px.mean);
+        }
+        if (adaptive_sampling && px.n >= std::max(min_samples, 2) && converged(px.m2, px.n)) {
+            return true;
+        }
+        return px.n >= sample_budget;
+    }
+
+    // Store a finished pixel's sample sum and count.
+    void store_pixel(int i, int j, const pixel_state& px, accumulation_buffer& sums, uint64_t& paths) {
+        sample_counts[size_t(j) * image_width + i] = px.n;
+        paths += px.n;
+        sums.add(i, j, px.sum, px.n); // Averaged when the buffer is resolved.
+        if (record_aovs && px.n > 0) {
+            size_t index = size_t(j) * image_width + i;
+            aov_output.albedo.set(i, j, (1.0 / px.n) * px.albedo_sum);
+            aov_output.normal.set(i, j, (1.0 / px.n) * px.normal_sum);
+            aov_output.depth[index] = px.hits > 0 ? float(px.depth_sum / px.hits) : 0.0f;
+            aov_output.variance[index] = px.n > 1 ? float(px.m2 / (px.n - 1) / px.n) : 0.0f;
+        }
+    }
+
+    // Add the auxiliary values of a sample's first ray to its pixel.
+    void add_first_hit(pixel_state& px, const ray& r, bool hit, const hit_record& rec) const {
+        if (!hit) {
+            px.albedo_sum += background(r); // The sky "reflects" its own color.
+            return;
+        }
+        px.albedo_sum += surface_albedo(rec);
+        px.normal_sum += rec.normal;
+        px.depth_sum += rec.t * r.direction().length(); // Camera rays are not normalized.
+        px.hits++;
+    }
+
+    // Check whether the standard error of a pixel's mean luminance is below the noise threshold.
+    bool converged(double m2, int n) const {
+        double variance = m2 / (n - 1); // Unbiased sample variance.
+        return variance / n <= noise_threshold * noise_threshold;
+    }
+
+    // Edge length of the tiles; at least one pixel, guarding against empty tiles.
+    int tile_edge() const { return (tile_size < 1) ? 1 : tile_size; }
 
     // Initialize camera parameters.
     void initialize() {
-        image_height = int(image_width / aspect_ratio); // Compute image height based on aspect ratio.
-        image_height = (image_height < 1) ? 1 : image_height; // Ensure minimum height of 1 pixel.
+        image_height = frame_height();
 
-        pixel_samples_scale = 1.0 / samples_per_pixel; // Compute scale factor for pixel color samples.
+        tile_size = tile_edge();
+        packet_size = std::min(packet_size, 8); // A packet holds at most max_packet_size (8x8) rays.
 
-        center = point3(0, 0, 0); // Set camera center.
+        center = lookfrom; // Set camera center.
 
-        auto focal_length = 1.0; // Focal length of the camera.
-        auto viewport_height = 2.0; // Height of the viewport.
+        auto focal_length = (lookfrom - lookat).length(); // Focal length of the camera.
+        auto h = std::tan(degrees_to_radians(vfov) / 2); // Half-height of the viewport per unit of distance.
+        auto viewport_height = 2 * h * focal_length; // Height of the viewport.
         auto viewport_width = viewport_height * (double(image_width) / image_height); // Width of the viewport.
 
-        auto viewport_u = vec3(viewport_width, 0, 0); // U-vector of the viewport.
-        auto viewport_v = vec3(0, -viewport_height, 0); // V-vector of the viewport.
+        vec3 w = unit_vector(lookfrom - lookat); // Camera frame: w points backwards, u right and v up.
+        vec3 u = unit_vector(cross(vup, w));
+        vec3 v = cross(w, u);
+
+        auto viewport_u = viewport_width * u; // U-vector of the viewport.
+        auto viewport_v = viewport_height * -v; // V-vector of the viewport.
 
         pixel_delta_u = viewport_u / image_width; // Compute change in pixel position along the u-axis.
         pixel_delta_v = viewport_v / image_height; // Compute change in pixel position along the v-axis.
 
-        auto viewport_upper_left = center - vec3(0, 0, focal_length) - viewport_u / 2 - viewport_v / 2; // Upper-left corner of the viewport.
+        auto viewport_upper_left = center - focal_length * w - viewport_u / 2 - viewport_v / 2; // Upper-left corner of the viewport.
         pixel00_loc = viewport_upper_left + 0.5 * (pixel_delta_u + pixel_delta_v); // Location of top-left pixel.
     }
 
     // Get the ray corresponding to a pixel and sample.
-    ray get_ray(int i, int j) const {
-        auto offset = sample_square(); // Sample offset within the pixel.
+    ray get_ray(int i, int j, pixel_sampler& numbers) const {
+        auto offset = sample_square(numbers); // Sample offset within the pixel.
         auto pixel_sample = pixel00_loc + ((i + offset.x()) * pixel_delta_u) + ((j + offset.y()) * pixel_delta_v); // Compute pixel location.
         auto ray_origin = center; // Camera origin.
         auto ray_direction = pixel_sample - ray_origin; // Ray direction.
@@ -83,21 +582,84 @@ private:
     }
 
     // Sample a point within the unit square.
-    vec3 sample_square() const {
-        return vec3(random_double() - 0.5, random_double() - 0.5, 0); // Return a random point within the unit square.
+    vec3 sample_square(pixel_sampler& numbers) const {
+        double u1, u2;
+        numbers.get_2d(u1, u2);
+        return vec3(u1 - 0.5, u2 - 0.5, 0); // Return a point within the unit square.
+    }
+
+    // Sampler for a sample of pixel (i, j).
+    pixel_sampler make_sampler(int i, int j, int sample) const {
+        return pixel_sampler(sampler, seed, i, j, size_t(j) * image_width + i, uint32_t(sample), uint32_t(std::max(samples_per_pixel, 1)));
     }
 
-    // Compute the color of a ray.
-    color ray_color(const ray& r, int depth, const hittable& world) const {
+    // Direction of a bounce, uniform over the hemisphere around the unit normal. The independent
+    // sampler takes a direct unit vector from the sample's stream and flips it into the
+    // hemisphere; the others map their next pair of dimensions directly, which keeps their
+    // stratification.
+    vec3 scatter_direction(pixel_sampler& numbers, const vec3& normal) const {
+        if (numbers.type() == sampler_kind::independent) {
+            return random_on_hemisphere(numbers.random(), normal);
+        }
+        double u1, u2;
+        numbers.get_2d(u1, u2);
+        return sample_uniform_hemisphere(u1, u2, normal);
+    }
+
+    // Compute the color of a ray by following its path iteratively. path_length receives the
+    // number of rays traced for this path; px receives the auxiliary values of its first hit.
+    color ray_color(const ray& r, const hittable& world, pixel_sampler& numbers, int& path_length, pixel_state& px) const {
+        if (max_depth <= 0) {
+            return color(0, 0, 0); // No rays to trace.
+        }
         hit_record rec; // Hit record for ray-object intersection.
-        if (depth <= 0) {
-            return color(0, 0, 0); // Return black if maximum depth is reached.
+        bool hit = world.hit(r, interval(0, infinity), rec); // Check for intersection with the scene.
+        if (record_aovs) {
+            add_first_hit(px, r, hit, rec);
         }
-        if (world.hit(r, interval(0, infinity), rec)) { // Check for intersection with the scene.
-            vec3 direction = random_on_hemisphere(rec.normal); // Random direction on the hemisphere.
-            return 0.5 * ray_color(ray(rec.p, direction), depth - 1, world); // Return color from bounced ray.
+        return continue_path(r, hit, rec, world, numbers, path_length);
+    }
+
+    // Follow a path whose first ray has already been traced: hit and rec are its result.
+    color continue_path(const ray& r, bool hit, hit_record rec, const hittable& world, pixel_sampler& numbers, int& path_length) const {
+        color throughput(1, 1, 1); // Fraction of light carried back along the path so far.
+        ray current = r;
+
+        for (int depth = 0; depth < max_depth; depth++) {
+            path_length = depth + 1;
+            if (depth > 0) {
+                hit = world.hit(current, interval(bounce_t_min, infinity), rec); // Trace the bounced ray.
+            }
+            if (!hit) {
+                return throughput * background(current); // The path escapes to the sky.
+            }
+
+            throughput = surface_albedo(rec) * throughput; // Each bounce absorbs half of the light.
+
+            // Russian roulette: past the minimum depth, end dim paths at random and boost survivors
+            // so the estimate stays unbiased.
+            if (russian_roulette && depth + 1 >= rr_min_depth) {
+                double survive = std::min(1.0, double(std::max({throughput.x(), throughput.y(), throughput.z()})));
+                if (numbers.get_1d() >= survive) {
+                    return color(0, 0, 0);
+                }
+                throughput = throughput / survive;
+            }
+
+            vec3 direction = scatter_direction(numbers, rec.normal); // Random direction on the hemisphere.
+            current = ray(rec.p, direction); // Continue with the bounced ray.
         }
-        // If no intersection, compute background color using a simple gradient.
+
+        return color(0, 0, 0); // Return black if maximum depth is reached.
+    }
+
+    // Fraction of light a surface reflects: every surface is a grey diffuse reflector.
+    color surface_albedo(const hit_record&) const {
+        return color(0.5, 0.5, 0.5);
+    }
+
+    // Background color for rays that leave the scene: a simple vertical gradient.
+    color background(const ray& r) const {
         vec3 unit_direction = unit_vector(r.direction()); // Unit direction of the ray.
         auto a = 0.5 * (unit_direction.y() + 1.0); // Scale factor based on ray direction.
         return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0); // Linear interpolation for gradient.
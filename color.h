@@ -13,17 +13,22 @@
 
 using color = vec3; // Alias for vec3 representing color.
 
+// Relative luminance of a linear color (Rec. 709 weights).
+inline double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// Convert a linear color component to a byte, clamping intensities to [0.0, 0.999].
+inline int color_to_byte(double component) {
+    static const basic_interval<double> intensity(0.0, 0.999);
+    return int(255.999 * intensity.clamp(component));
+}
+
 // Function to write color information to output stream.
-void write_color(std::ostream& out, const color& pixel_color) {
-    auto r = pixel_color.x(); // Red component of the pixel color.
-    auto g = pixel_color.y(); // Green component of the pixel color.
-    auto b = pixel_color.z(); // Blue component of the pixel color.
-
-    // Clamp color intensities to the range [0.0, 0.999] and convert to byte values.
-    static const interval intensity(0.0, 0.999);
-    int rbyte = int(255.999 * intensity.clamp(r)); // Convert and clamp red intensity.
-    int gbyte = int(255.999 * intensity.clamp(g)); // Convert and clamp green intensity.
-    int bbyte = int(255.999 * intensity.clamp(b)); // Convert and clamp blue intensity.
+inline void write_color(std::ostream& out, const color& pixel_color) {
+    int rbyte = color_to_byte(pixel_color.x()); // Convert and clamp red intensity.
+    int gbyte = color_to_byte(pixel_color.y()); // Convert and clamp green intensity.
+    int bbyte = color_to_byte(pixel_color.z()); // Convert and clamp blue intensity.
 
     // Write the color values to the output stream.
     out << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
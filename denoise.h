@@ -0,0 +1,193 @@
+/***************************************************************
+* Description: Header file for the denoiser, an edge-aware     *
+*              a-trous wavelet filter guided by a render's     *
+*              auxiliary buffers.                              *
+***************************************************************/
+
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "framebuffer.h"
+#include "aov.h"
+#include "thread_pool.h"
+#include "simd.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <cmath>
+#include <vector>
+
+// Settings of the denoiser.
+struct denoise_options {
+    int iterations = 5; // Filter passes; pass i spaces its 5x5 taps 2^i pixels apart.
+    float sigma_luminance = 4; // Luminance edge stopping, in standard deviations of the pixel's noise.
+    float sigma_normal = 128; // Normal edge stopping: roughly the exponent applied to the cosine between normals.
+    float sigma_depth = 1; // Depth edge stopping, in multiples of the depth change expected along a surface.
+    int thread_count = 0; // Filter threads (0 = use every hardware thread).
+};
+
+// Cheap stand-in for exp(-x), x >= 0: the reciprocal of exp's fourth-order Taylor series. It falls
+// off like exp near zero with a slightly heavier tail, and unlike std::exp it vectorizes.
+inline float falloff(float x) {
+    return 1.0f / (1.0f + x * (1.0f + x * (0.5f + x * (1.0f / 6.0f + x * (1.0f / 24.0f)))));
+}
+
+// Denoise an image with the edge-avoiding a-trous wavelet filter (Dammertz et al., HPG 2010), with
+// the luminance weight scaled by each pixel's estimated noise as in SVGF (Schied et al., HPG 2017).
+// The image is divided by the albedo first, so texture-like detail in the albedo is not blurred,
+// then filtered repeatedly with widening 5x5 kernels whose weights drop across normal, depth and
+// (noise-relative) luminance edges. Works on planes of floats so the inner loops vectorize; rows
+// are filtered in parallel. aovs must be the size of noisy.
+inline void denoise(const framebuffer& noisy, const aov_buffers& aovs, framebuffer& output,
+                    const denoise_options& options = denoise_options()) {
+    const int w = noisy.width(), h = noisy.height();
+    const size_t n = size_t(w) * h;
+    const float epsilon = 1e-4f;
+
+    // Split the inputs into planes: demodulated color, its variance, unit normals and depth gradients.
+    std::vector<float> r(n), g(n), b(n), var(n), nx(n), ny(n), nz(n), z(n), zdx(n), zdy(n);
+    for (size_t i = 0; i < n; i++) {
+        const float* c = noisy.data() + 3 * i;
+        const float* a = aovs.albedo.data() + 3 * i;
+        float ar = std::max(a[0], epsilon), ag = std::max(a[1], epsilon), ab = std::max(a[2], epsilon);
+        r[i] = c[0] / ar;
+        g[i] = c[1] / ag;
+        b[i] = c[2] / ab;
+        float albedo_luminance = 0.2126f * ar + 0.7152f * ag + 0.0722f * ab;
+        var[i] = aovs.variance[i] / (albedo_luminance * albedo_luminance);
+
+        const float* nrm = aovs.normal.data() + 3 * i;
+        float length = std::sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+        float scale = length > 0 ? 1 / length : 0; // Misses keep a zero normal.
+        nx[i] = nrm[0] * scale;
+        ny[i] = nrm[1] * scale;
+        nz[i] = nrm[2] * scale;
+        z[i] = aovs.depth[i];
+    }
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            size_t i = size_t(y) * w + x;
+            size_t left = i - (x > 0), right = i + (x + 1 < w), up = i - (y > 0 ? w : 0), down = i + (y + 1 < h ? w : 0);
+            zdx[i] = std::fabs(z[right] - z[left]) / std::max(int(right - left), 1); // Depth change per pixel.
+            zdy[i] = std::fabs(z[down] - z[up]) / std::max(int((down - up) / w), 1);
+        }
+    }
+
+    std::vector<float> out_r(n), out_g(n), out_b(n), out_var(n);
+    std::vector<float> luminance_scale(n); // Per-pass luminance weight denominator of each pixel.
+    static const float kernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16}; // B3 spline.
+
+    thread_pool pool(options.thread_count);
+    for (int pass = 0; pass < options.iterations; pass++) {
+        const int step = 1 << pass;
+
+        // Noise estimate of each pixel: its variance blurred over 3x3 pixels, which is steadier.
+        pool.parallel_for(0, h, [&](int y) {
+            for (int x = 0; x < w; x++) {
+                float sum = 0, weight = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int qx = x + dx, qy = y + dy;
+                        if (qx >= 0 && qx < w && qy >= 0 && qy < h) {
+                            float k = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                            sum += k * var[size_t(qy) * w + qx];
+                            weight += k;
+                        }
+                    }
+                }
+                luminance_scale[size_t(y) * w + x] = 1 / (options.sigma_luminance * std::sqrt(sum / weight) + epsilon);
+            }
+        });
+
+        // One a-trous pass, row by row. Each tap is applied to a whole row at once: the loop over x
+        // reads contiguous planes through plain pointers and has no branches, so it vectorizes.
+        pool.parallel_for(0, h, [&](int y) {
+            std::vector<float> sums(5 * size_t(w), 0.0f);
+            float* sum_w = sums.data(); // Weights and weighted values of the row's pixels.
+            float* sum_r = sum_w + w;
+            float* sum_g = sum_r + w;
+            float* sum_b = sum_g + w;
+            float* sum_v = sum_b + w;
+            const float sigma_normal = options.sigma_normal, sigma_depth = options.sigma_depth;
+            const size_t row = size_t(y) * w;
+
+            for (int ty = -2; ty <= 2; ty++) {
+                int qy = y + ty * step;
+                if (qy < 0 || qy >= h) {
+                    continue;
+                }
+                for (int tx = -2; tx <= 2; tx++) {
+                    const int offset = tx * step;
+                    const int x_begin = std::max(0, -offset), x_end = std::min(w, w - offset); // Taps inside the image.
+                    if (x_begin >= x_end) {
+                        continue; // The step is wider than the image.
+                    }
+                    const int span = x_end - x_begin;
+                    const float k = kernel[tx + 2] * kernel[ty + 2];
+                    const float dist_x = float(std::abs(offset)), dist_y = float(std::abs(ty * step));
+                    const size_t p0 = row + x_begin, q0 = size_t(qy) * w + x_begin + offset; // Plane indices of the first pixel and its tap.
+
+                    // The pixels (p) from x_begin and their taps (q) in every plane; every index i in
+                    // [0, span) addresses an element inside the image.
+                    const float *rp = r.data() + p0, *gp = g.data() + p0, *bp = b.data() + p0;
+                    const float *rq = r.data() + q0, *gq = g.data() + q0, *bq = b.data() + q0;
+                    const float *nxp = nx.data() + p0, *nyp = ny.data() + p0, *nzp = nz.data() + p0;
+                    const float *nxq = nx.data() + q0, *nyq = ny.data() + q0, *nzq = nz.data() + q0;
+                    const float *zp = z.data() + p0, *zq = z.data() + q0, *zdxp = zdx.data() + p0, *zdyp = zdy.data() + p0;
+                    const float *vq = var.data() + q0, *scale_p = luminance_scale.data() + p0;
+                    float *acc_w = sum_w + x_begin, *acc_r = sum_r + x_begin, *acc_g = sum_g + x_begin;
+                    float *acc_b = sum_b + x_begin, *acc_v = sum_v + x_begin;
+                    RT_INDEPENDENT_LOOP
+                    for (int i = 0; i < span; i++) {
+                        // Normals: about cosine^sigma_normal; a miss only blends with other misses.
+                        float cosine = nxp[i] * nxq[i] + nyp[i] * nyq[i] + nzp[i] * nzq[i];
+                        float w_cosine = falloff(sigma_normal * std::max(1 - cosine, 0.0f));
+                        float hit_p = zp[i] > 0 ? 1.0f : 0.0f, hit_q = zq[i] > 0 ? 1.0f : 0.0f;
+                        float w_normal = hit_p * hit_q * w_cosine + (1 - hit_p) * (1 - hit_q);
+
+                        // Depth: compared with the change the surface's gradient predicts over the distance.
+                        float expected = sigma_depth * (zdxp[i] * dist_x + zdyp[i] * dist_y) + epsilon;
+                        float w_depth = falloff(std::fabs(zp[i] - zq[i]) / expected);
+
+                        // Luminance: differences that the pixel's noise explains are smoothed away.
+                        float lp = 0.2126f * rp[i] + 0.7152f * gp[i] + 0.0722f * bp[i];
+                        float lq = 0.2126f * rq[i] + 0.7152f * gq[i] + 0.0722f * bq[i];
+                        float w_luminance = falloff(std::fabs(lp - lq) * scale_p[i]);
+
+                        float weight = k * w_normal * w_depth * w_luminance;
+                        acc_w[i] += weight;
+                        acc_r[i] += weight * rq[i];
+                        acc_g[i] += weight * gq[i];
+                        acc_b[i] += weight * bq[i];
+                        acc_v[i] += weight * weight * vq[i];
+                    }
+                }
+            }
+            float *new_r = &out_r[row], *new_g = &out_g[row], *new_b = &out_b[row], *new_var = &out_var[row];
+            RT_INDEPENDENT_LOOP
+            for (int x = 0; x < w; x++) {
+                float inv = 1 / sum_w[x]; // The center tap always has weight k > 0.
+                new_r[x] = sum_r[x] * inv;
+                new_g[x] = sum_g[x] * inv;
+                new_b[x] = sum_b[x] * inv;
+                new_var[x] = sum_v[x] * inv * inv; // Variance of the weighted mean.
+            }
+        });
+        r.swap(out_r);
+        g.swap(out_g);
+        b.swap(out_b);
+        var.swap(out_var);
+    }
+
+    // Put the albedo back.
+    output.resize(w, h);
+    for (size_t i = 0; i < n; i++) {
+        const float* a = aovs.albedo.data() + 3 * i;
+        float* c = output.data() + 3 * i;
+        c[0] = r[i] * std::max(a[0], epsilon);
+        c[1] = g[i] * std::max(a[1], epsilon);
+        c[2] = b[i] * std::max(a[2], epsilon);
+    }
+}
+
+#endif // DENOISE_H
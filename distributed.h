@@ -0,0 +1,294 @@
+/***************************************************************
+* Description: Header file for distributed rendering: a frame  *
+*              is split into tile or sample ranges, rendered   *
+*              by worker processes and merged (POSIX only).    *
+***************************************************************/
+
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "camera.h"
+#include "accumulation.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h> // POSIX headers for processes and sockets.
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// How a frame is divided between workers.
+enum class split_mode {
+    tiles, // Ranges of tile rows; every pixel is rendered by one worker, so the image is bit-identical.
+    samples // Ranges of sample indices over the whole frame; sums are merged in a fixed order.
+};
+
+// Settings of a distributed render.
+struct distributed_options {
+    int workers = 2; // Worker processes.
+    split_mode split = split_mode::tiles; // How the frame is divided.
+    int jobs_per_worker = 4; // Tile ranges handed out per worker; more ranges balance the load better.
+};
+
+// What a distributed render did.
+struct distributed_report {
+    uint64_t rays = 0; // Rays traced by all workers.
+    uint64_t paths = 0; // Camera paths traced by all workers.
+    double seconds = 0; // Wall-clock time of the whole render.
+    int jobs = 0; // Ranges the frame was split into.
+    int lost_workers = 0; // Workers that died; their ranges went to the others.
+};
+
+// A range of the frame sent to a worker, and the rows its result covers.
+struct distributed_job {
+    int32_t tile_begin, tile_end; // Tiles to render.
+    int32_t sample_begin, sample_end; // Sample indices to take.
+    int32_t row_begin, row_end; // Rows holding the rendered tiles.
+};
+
+// Header of a worker's result; sums (3 doubles per pixel) and counts (1 int per pixel) of the
+// rows follow.
+struct distributed_result {
+    int32_t row_begin, row_end; // Rows of the result.
+    uint64_t rays, paths; // Rays and paths traced for the job.
+};
+
+// Send or receive exactly size bytes over a socket. Returns false if the other side is gone.
+inline bool send_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL); // A closed peer is an error, not a SIGPIPE.
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+inline bool receive_all(int fd, void* data, size_t size) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = ::recv(fd, p, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+// Body of a worker process: render the jobs read from fd and send back their rows until the
+// coordinator closes the socket.
+inline void run_render_worker(int fd, camera& cam, const hittable& world) {
+    accumulation_buffer sums;
+    distributed_job job;
+    while (receive_all(fd, &job, sizeof(job))) {
+        render_range range;
+        range.tile_begin = job.tile_begin;
+        range.tile_end = job.tile_end;
+        range.sample_begin = job.sample_begin;
+        range.sample_end = job.sample_end;
+        cam.render(world, range, sums);
+
+        distributed_result result = {job.row_begin, job.row_end, cam.rays_traced(), cam.paths_traced()};
+        size_t first = size_t(job.row_begin) * sums.width(), pixels = size_t(job.row_end - job.row_begin) * sums.width();
+        if (!send_all(fd, &result, sizeof(result)) ||
+            !send_all(fd, sums.sum_data() + 3 * first, 3 * pixels * sizeof(double)) ||
+            !send_all(fd, sums.count_data() + first, pixels * sizeof(int))) {
+            return;
+        }
+    }
+}
+
+// Render a frame with worker processes forked from this one: each inherits the camera and the
+// world, renders the ranges it is sent, and returns their sample sums over a local socket. Ranges
+// are handed out as workers become free, and their results are merged in range order, so the
+// image does not depend on the scheduling. Call it while no other threads run in this process
+// (forking copies only the calling thread). Returns false and sets error on failure.
+inline bool render_distributed(camera cam, const hittable& world, const distributed_options& options,
+                               accumulation_buffer& sums, distributed_report& report, std::string& error) {
+    int workers = std::max(options.workers, 1);
+    if (options.split == split_mode::samples && cam.adaptive_sampling) {
+        error = "adaptive sampling decides per pixel when to stop, so it needs the frame split into tiles";
+        return false;
+    }
+
+    int width = cam.image_width, height = cam.frame_height();
+    int tiles_x = cam.frame_tiles_x(), tiles_y = cam.frame_tiles_y();
+    int tile_edge = std::max(cam.tile_size, 1); // Same as the camera's tile size.
+
+    // Split the frame into ranges.
+    std::vector<distributed_job> jobs;
+    if (options.split == split_mode::tiles) {
+        int wanted = workers * std::max(options.jobs_per_worker, 1);
+        int rows_per_job = std::max((tiles_y + wanted - 1) / wanted, 1); // Tile rows per range.
+        for (int row = 0; row < tiles_y; row += rows_per_job) {
+            int last = std::min(row + rows_per_job, tiles_y);
+            jobs.push_back({row * tiles_x, last * tiles_x, 0, -1, row * tile_edge, std::min(last * tile_edge, height)});
+        }
+    }
+    else {
+        for (int w = 0; w < workers; w++) {
+            int begin = int(int64_t(cam.samples_per_pixel) * w / workers), end = int(int64_t(cam.samples_per_pixel) * (w + 1) / workers);
+            if (end > begin) {
+                jobs.push_back({0, -1, begin, end, 0, height});
+            }
+        }
+    }
+    workers = std::min(workers, int(jobs.size()));
+
+    // Workers share the machine, so by default each takes its share of the hardware threads.
+    bool show_progress = cam.show_progress; // Progress is reported by the coordinator only.
+    cam.show_progress = false;
+    if (cam.thread_count <= 0) {
+        cam.thread_count = std::max(int(std::thread::hardware_concurrency()) / std::max(workers, 1), 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::fflush(nullptr); // Buffered output must not be written again by the children.
+    std::clog.flush();
+
+    std::vector<int> sockets; // Coordinator end of each worker's socket (-1 once the worker is gone).
+    std::vector<pid_t> pids;
+    for (int w = 0; w < workers; w++) {
+        int pair[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            error = "cannot create a socket for worker " + std::to_string(w);
+            break;
+        }
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            for (int fd : sockets) {
+                ::close(fd); // Leave other workers' sockets to the coordinator, so they see it close.
+            }
+            ::close(pair[0]);
+            run_render_worker(pair[1], cam, world);
+            ::_exit(0); // Skip the parent's exit handlers and destructors.
+        }
+        ::close(pair[1]);
+        if (pid < 0) {
+            ::close(pair[0]);
+            error = "cannot start worker " + std::to_string(w);
+            break;
+        }
+        sockets.push_back(pair[0]);
+        pids.push_back(pid);
+    }
+
+    // Hand out ranges as workers become free and collect their results.
+    std::vector<std::vector<double>> job_sums(jobs.size()); // Results, merged in range order at the end.
+    std::vector<std::vector<int>> job_counts(jobs.size());
+    std::vector<int> todo; // Ranges waiting for a worker, last one first.
+    for (int j = int(jobs.size()) - 1; j >= 0; j--) {
+        todo.push_back(j);
+    }
+    std::vector<int> running(sockets.size(), -1); // Range each worker is rendering (-1 = idle).
+    size_t done = 0;
+    report = distributed_report();
+    report.jobs = int(jobs.size());
+
+    auto lose_worker = [&](size_t w) {
+        ::close(sockets[w]);
+        sockets[w] = -1;
+        if (running[w] >= 0) {
+            todo.push_back(running[w]); // Someone else renders it.
+            running[w] = -1;
+        }
+        report.lost_workers++;
+    };
+
+    while (done < jobs.size()) {
+        for (size_t w = 0; w < sockets.size(); w++) {
+            if (sockets[w] >= 0 && running[w] < 0 && !todo.empty()) {
+                running[w] = todo.back();
+                todo.pop_back();
+                if (!send_all(sockets[w], &jobs[running[w]], sizeof(distributed_job))) {
+                    lose_worker(w);
+                }
+            }
+        }
+
+        std::vector<pollfd> busy;
+        std::vector<size_t> busy_worker;
+        for (size_t w = 0; w < sockets.size(); w++) {
+            if (sockets[w] >= 0 && running[w] >= 0) {
+                busy.push_back({sockets[w], POLLIN, 0});
+                busy_worker.push_back(w);
+            }
+        }
+        if (busy.empty()) {
+            if (error.empty()) {
+                error = "every worker process failed";
+            }
+            break;
+        }
+        if (::poll(busy.data(), nfds_t(busy.size()), -1) < 0) {
+            continue; // Interrupted by a signal.
+        }
+
+        for (size_t b = 0; b < busy.size(); b++) {
+            if (busy[b].revents == 0) {
+                continue;
+            }
+            size_t w = busy_worker[b];
+            int j = running[w];
+            distributed_result result;
+            size_t pixels = size_t(jobs[j].row_end - jobs[j].row_begin) * width;
+            job_sums[j].resize(3 * pixels);
+            job_counts[j].resize(pixels);
+            if (!receive_all(sockets[w], &result, sizeof(result)) ||
+                result.row_begin != jobs[j].row_begin || result.row_end != jobs[j].row_end ||
+                !receive_all(sockets[w], job_sums[j].data(), 3 * pixels * sizeof(double)) ||
+                !receive_all(sockets[w], job_counts[j].data(), pixels * sizeof(int))) {
+                lose_worker(w);
+                continue;
+            }
+            report.rays += result.rays;
+            report.paths += result.paths;
+            running[w] = -1;
+            done++;
+            if (show_progress) {
+                std::clog << "\rRanges remaining: " << jobs.size() - done << ' ' << std::flush; // Output progress.
+            }
+        }
+    }
+
+    // Closing the sockets tells the workers to exit.
+    for (int fd : sockets) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    for (pid_t pid : pids) {
+        int status;
+        ::waitpid(pid, &status, 0);
+    }
+    if (done < jobs.size()) {
+        return false;
+    }
+    error.clear();
+
+    sums.resize(width, height);
+    for (size_t j = 0; j < jobs.size(); j++) {
+        sums.merge_rows(jobs[j].row_begin, jobs[j].row_end, job_sums[j].data(), job_counts[j].data());
+    }
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (show_progress) {
+        std::clog << "\rDone.                 \n"; // Output completion message.
+    }
+    return true;
+}
+
+#endif // DISTRIBUTED_H
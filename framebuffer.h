@@ -0,0 +1,70 @@
+/***************************************************************
+* Description: Header file for the framebuffer class, which    *
+*              holds the linear float radiance of a rendered   *
+*              image until it is written out in one go.        *
+***************************************************************/
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "rt_general.h" // Include necessary header files.
+
+#include <algorithm> // Include necessary standard library headers.
+#include <vector>
+
+// Class representing an image as interleaved linear RGB floats, row by row from the top.
+class framebuffer {
+public:
+    // Constructors:
+    framebuffer() {} // Default constructor creates an empty 0x0 image.
+    framebuffer(int width, int height) { resize(width, height); }
+
+    // Change the image size; all pixels become black.
+    void resize(int width, int height) {
+        w = (width < 0) ? 0 : width;
+        h = (height < 0) ? 0 : height;
+        pixels.assign(size_t(w) * h * 3, 0.0f);
+    }
+
+    // Set every pixel to black.
+    void clear() { std::fill(pixels.begin(), pixels.end(), 0.0f); }
+
+    // Accessor functions for the image size.
+    int width() const { return w; }
+    int height() const { return h; }
+
+    // Read the color of pixel (x, y).
+    color get(int x, int y) const {
+        const float* p = &pixels[index(x, y)];
+        return color(p[0], p[1], p[2]);
+    }
+
+    // Overwrite pixel (x, y).
+    void set(int x, int y, const color& c) {
+        float* p = &pixels[index(x, y)];
+        p[0] = float(c.x());
+        p[1] = float(c.y());
+        p[2] = float(c.z());
+    }
+
+    // Add radiance to pixel (x, y).
+    void add(int x, int y, const color& c) {
+        float* p = &pixels[index(x, y)];
+        p[0] += float(c.x());
+        p[1] += float(c.y());
+        p[2] += float(c.z());
+    }
+
+    // Raw access to the interleaved RGB floats (width * height * 3 values).
+    const float* data() const { return pixels.data(); }
+    float* data() { return pixels.data(); }
+
+private:
+    int w = 0; // Width in pixels.
+    int h = 0; // Height in pixels.
+    std::vector<float> pixels; // Interleaved RGB radiance.
+
+    size_t index(int x, int y) const { return (size_t(y) * w + x) * 3; }
+};
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,45 @@
+/***************************************************************
+* Description: Header file for the heat-map helper, which turns *
+*              a per-pixel scalar (samples spent, cost, ...)   *
+*              into a false-color framebuffer.                 *
+***************************************************************/
+
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "framebuffer.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <vector>
+
+// Map t in [0, 1] to a blue -> cyan -> green -> yellow -> red ramp.
+inline color heat_color(double t) {
+    static const color ramp[] = {color(0, 0, 0.5), color(0, 0.6, 1), color(0, 0.8, 0.2), color(1, 0.9, 0), color(0.9, 0, 0)};
+    t = interval(0, 1).clamp(t) * 4; // Position along the four ramp segments.
+    int k = std::min(int(t), 3);
+    double f = t - k;
+    return (1 - f) * ramp[k] + f * ramp[k + 1];
+}
+
+// Build a heat-map image from one value per pixel (row by row from the top). Values are scaled
+// so that max_value (by default the largest value) maps to red.
+template <typename T>
+framebuffer make_heatmap(const std::vector<T>& values, int width, int height, double max_value = 0) {
+    if (max_value <= 0) {
+        for (const auto& v : values) {
+            max_value = std::max(max_value, double(v));
+        }
+    }
+    double scale = (max_value > 0) ? 1.0 / max_value : 0;
+
+    framebuffer image(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            image.set(x, y, heat_color(double(values[size_t(y) * width + x]) * scale));
+        }
+    }
+    return image;
+}
+
+#endif // HEATMAP_H
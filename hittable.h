@@ -7,13 +7,14 @@
 #define HITTABLE_H
 
 #include "rt_general.h" // Include necessary header files.
+#include "aabb.h"
 
 // Class representing information about a hit between a ray and an object.
 class hit_record {
 public:
     point3 p; // Point of intersection.
     vec3 normal; // Surface normal at the point of intersection.
-    double t; // Parameter value of the hit along the ray.
+    real t; // Parameter value of the hit along the ray.
     bool front_face; // Indicates whether the ray hits the front or back side of the object.
 
     // Set the face normal based on the ray direction and outward normal.
@@ -23,6 +24,8 @@ public:
     }
 };
 
+constexpr int max_packet_size = 64; // Most rays traced together by hit_packet (an 8x8 pixel block).
+
 // Abstract base class for hittable objects.
 class hittable {
 public:
@@ -30,6 +33,25 @@ public:
 
     // Method to check for ray-object intersection.
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+    // Method to check whether a ray hits anything at all within ray_t (occlusion query). It may
+    // stop at the first hit found; the default falls back to hit().
+    virtual bool any_hit(const ray& r, interval ray_t) const {
+        hit_record rec;
+        return hit(r, ray_t, rec);
+    }
+
+    // Method to trace a packet of up to max_packet_size rays at once: hits[k] tells whether rays[k]
+    // hit anything within ray_t, and recs[k] holds the closest hit if so. Results match hit() ray
+    // by ray; the default just calls it for each ray, acceleration structures share work instead.
+    virtual void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const {
+        for (int k = 0; k < count; k++) {
+            hits[k] = hit(rays[k], ray_t, recs[k]);
+        }
+    }
+
+    // Method returning a box that encloses the whole object, used to build acceleration structures.
+    virtual aabb bounding_box() const = 0;
 };
 
 #endif // HITTABLE_H
\ No newline at end of file
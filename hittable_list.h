@@ -9,6 +9,7 @@
 
 #include "hittable.h" // Include necessary header files.
 #include "rt_general.h"
+#include "stats.h"
 
 #include <vector> // Include necessary standard library headers.
 
@@ -22,11 +23,15 @@ public:
     hittable_list(shared_ptr<hittable> object) { add(object); } // Constructor with initial object.
 
     // Clear the list of objects.
-    void clear() { objects.clear(); }
+    void clear() {
+        objects.clear();
+        bbox = aabb(); // Reset the bounding box to empty.
+    }
 
     // Add a new object to the list.
     void add(shared_ptr<hittable> object) {
         objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box()); // Grow the bounding box to include the object.
     }
 
     // Method to check for ray-object intersection with all objects in the list.
@@ -34,6 +39,8 @@ public:
         hit_record temp_rec; // Temporary hit record.
         bool hit_anything = false; // Flag indicating if any object is hit.
         auto closest_so_far = ray_t.max; // Initialize closest intersection parameter to the maximum value.
+        RT_STAT_ADD(hit_calls, 1);
+        RT_STAT_ADD(primitive_tests, objects.size());
 
         // Iterate over all objects in the list.
         for (const auto& object : objects) {
@@ -47,6 +54,22 @@ public:
 
         return hit_anything; // Return whether any object is hit.
     }
+
+    // Method to check whether any object in the list is hit, stopping at the first one.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        for (const auto& object : objects) {
+            if (object->any_hit(r, ray_t)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Method returning the bounding box of all objects in the list.
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    aabb bbox; // Bounding box enclosing every object in the list.
 };
 
 #endif // HITTABLE_LIST_H
\ No newline at end of file
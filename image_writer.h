@@ -0,0 +1,317 @@
+/***************************************************************
+* Description: Header file for the image writers, which encode *
+*              a framebuffer as PPM, PNG or PFM in memory and  *
+*              write the whole file with a single call, plus a *
+*              PFM reader for reference images.                *
+***************************************************************/
+
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "framebuffer.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef RT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// Supported output file formats.
+enum class image_format {
+    ppm_ascii, // Plain-text PPM (P3), the renderer's original output.
+    ppm, // Binary PPM (P6), 8 bits per channel.
+    png, // PNG, 8 bits per channel.
+    pfm, // Portable float map: linear 32-bit floats, for HDR.
+    unknown
+};
+
+using byte_buffer = std::vector<unsigned char>; // An encoded file held in memory.
+
+// Look up a format by name ("ppm", "ppm-ascii", "png", "pfm").
+inline image_format parse_image_format(const std::string& name) {
+    if (name == "ppm" || name == "p6") return image_format::ppm;
+    if (name == "ppm-ascii" || name == "p3") return image_format::ppm_ascii;
+    if (name == "png") return image_format::png;
+    if (name == "pfm") return image_format::pfm;
+    return image_format::unknown;
+}
+
+// Guess the format from a file name's extension. A name without an extension (or "-", standard
+// output) gets plain-text PPM; an extension that names no format gives unknown, so a typo such
+// as ".pgn" is reported instead of writing text under that name.
+inline image_format image_format_from_path(const std::string& path) {
+    auto slash = path.find_last_of("/\\");
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return image_format::ppm_ascii;
+    }
+    std::string ext = path.substr(dot + 1);
+    for (auto& ch : ext) {
+        ch = char(std::tolower((unsigned char)ch));
+    }
+    return parse_image_format(ext);
+}
+
+// Append text to a buffer.
+inline void append_text(byte_buffer& out, const std::string& text) {
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+// Encode as plain-text PPM (P3), matching write_color.
+inline byte_buffer encode_ppm_ascii(const framebuffer& image) {
+    byte_buffer out;
+    append_text(out, "P3\n" + std::to_string(image.width()) + ' ' + std::to_string(image.height()) + "\n255\n");
+    out.reserve(out.size() + size_t(image.width()) * image.height() * 12);
+
+    char line[16];
+    const float* p = image.data();
+    size_t pixel_count = size_t(image.width()) * image.height();
+    for (size_t i = 0; i < pixel_count; i++, p += 3) {
+        int n = std::snprintf(line, sizeof(line), "%d %d %d\n", color_to_byte(p[0]), color_to_byte(p[1]), color_to_byte(p[2]));
+        out.insert(out.end(), line, line + n);
+    }
+    return out;
+}
+
+// Convert the framebuffer to 8-bit RGB rows.
+inline byte_buffer to_rgb8(const framebuffer& image) {
+    size_t count = size_t(image.width()) * image.height() * 3;
+    byte_buffer out(count);
+    const float* p = image.data();
+    for (size_t i = 0; i < count; i++) {
+        out[i] = (unsigned char)color_to_byte(p[i]);
+    }
+    return out;
+}
+
+// Encode as binary PPM (P6).
+inline byte_buffer encode_ppm(const framebuffer& image) {
+    byte_buffer out;
+    append_text(out, "P6\n" + std::to_string(image.width()) + ' ' + std::to_string(image.height()) + "\n255\n");
+    byte_buffer rgb = to_rgb8(image);
+    out.insert(out.end(), rgb.begin(), rgb.end());
+    return out;
+}
+
+// Encode as PFM: little-endian RGB floats, rows stored bottom to top.
+inline byte_buffer encode_pfm(const framebuffer& image) {
+    byte_buffer out;
+    append_text(out, "PF\n" + std::to_string(image.width()) + ' ' + std::to_string(image.height()) + "\n-1.0\n");
+
+    size_t row_bytes = size_t(image.width()) * 3 * sizeof(float);
+    size_t header = out.size();
+    out.resize(header + row_bytes * image.height());
+    for (int y = 0; y < image.height(); y++) {
+        const float* row = image.data() + size_t(image.height() - 1 - y) * image.width() * 3;
+        std::memcpy(&out[header + row_bytes * y], row, row_bytes); // Assumes a little-endian host.
+    }
+    return out;
+}
+
+// CRC-32 as used by PNG chunks.
+inline uint32_t png_crc32(uint32_t crc, const unsigned char* data, size_t length) {
+    static const auto table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : (c >> 1);
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Append a 32-bit big-endian integer.
+inline void append_be32(byte_buffer& out, uint32_t v) {
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+// Append a PNG chunk (length, type, data, CRC).
+inline void append_png_chunk(byte_buffer& out, const char* type, const byte_buffer& data) {
+    append_be32(out, uint32_t(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    append_be32(out, png_crc32(0, &out[start], out.size() - start));
+}
+
+// Wrap raw bytes in a zlib stream. Uses zlib when available, otherwise stored (uncompressed) blocks.
+inline byte_buffer zlib_compress(const byte_buffer& raw) {
+#ifdef RT_HAVE_ZLIB
+    uLongf size = compressBound(uLong(raw.size()));
+    byte_buffer compressed(size);
+    if (compress2(compressed.data(), &size, raw.data(), uLong(raw.size()), 6) == Z_OK) {
+        compressed.resize(size);
+        return compressed;
+    }
+#endif
+    byte_buffer out = {0x78, 0x01}; // zlib header: deflate, no preset dictionary.
+    size_t pos = 0;
+    do {
+        size_t block = std::min<size_t>(raw.size() - pos, 65535);
+        bool last = (pos + block == raw.size());
+        out.push_back(last ? 1 : 0); // Stored block header.
+        out.push_back((unsigned char)(block & 0xff));
+        out.push_back((unsigned char)(block >> 8));
+        out.push_back((unsigned char)(~block & 0xff));
+        out.push_back((unsigned char)((~block >> 8) & 0xff));
+        out.insert(out.end(), raw.begin() + pos, raw.begin() + pos + block);
+        pos += block;
+    } while (pos < raw.size());
+
+    uint32_t a = 1, b = 0; // Adler-32 checksum of the raw data.
+    for (unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    append_be32(out, (b << 16) | a);
+    return out;
+}
+
+// Encode as an 8-bit RGB PNG.
+inline byte_buffer encode_png(const framebuffer& image) {
+    int w = image.width(), h = image.height();
+    byte_buffer rgb = to_rgb8(image);
+
+    // Filter every row with "Up" (difference to the row above), which suits smooth gradients.
+    size_t stride = size_t(w) * 3;
+    byte_buffer filtered;
+    filtered.reserve((stride + 1) * h);
+    for (int y = 0; y < h; y++) {
+        filtered.push_back(2);
+        const unsigned char* row = &rgb[stride * y];
+        for (size_t i = 0; i < stride; i++) {
+            unsigned char above = (y > 0) ? row[i - stride] : 0;
+            filtered.push_back((unsigned char)(row[i] - above));
+        }
+    }
+
+    byte_buffer out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    byte_buffer ihdr;
+    append_be32(ihdr, uint32_t(w));
+    append_be32(ihdr, uint32_t(h));
+    ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, adaptive filters, no interlace.
+    append_png_chunk(out, "IHDR", ihdr);
+    append_png_chunk(out, "IDAT", zlib_compress(filtered));
+    append_png_chunk(out, "IEND", byte_buffer());
+    return out;
+}
+
+// Encode an image in the given format.
+inline byte_buffer encode_image(const framebuffer& image, image_format format) {
+    switch (format) {
+        case image_format::ppm: return encode_ppm(image);
+        case image_format::png: return encode_png(image);
+        case image_format::pfm: return encode_pfm(image);
+        default: return encode_ppm_ascii(image);
+    }
+}
+
+// Write a whole buffer to a file ("-" means standard output) with a single write. Returns
+// whether it succeeded.
+inline bool write_file(const std::string& path, const byte_buffer& bytes) {
+    FILE* file = stdout;
+    if (path == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY); // Keep binary formats intact on Windows.
+#endif
+    }
+    else {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+    }
+
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    ok = (std::fflush(file) == 0) && ok;
+    if (file != stdout) {
+        ok = (std::fclose(file) == 0) && ok;
+    }
+    return ok;
+}
+
+// Encode and write an image in one go. Returns whether it succeeded (never for an unknown format).
+inline bool write_image(const std::string& path, image_format format, const framebuffer& image) {
+    if (format == image_format::unknown) {
+        return false;
+    }
+    return write_file(path, encode_image(image, format));
+}
+
+// Read a whole file into memory. Returns whether it succeeded.
+inline bool read_file(const std::string& path, byte_buffer& bytes) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bytes.clear();
+    unsigned char chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+// Decode a little-endian color PFM as written by encode_pfm, so reference renders can be
+// compared. Returns whether it succeeded; error says why not.
+inline bool decode_pfm(const byte_buffer& bytes, framebuffer& image, std::string& error) {
+    // Header: "PF", width, height and scale, separated by whitespace, then one whitespace byte.
+    std::string fields[4];
+    size_t pos = 0;
+    for (auto& field : fields) {
+        while (pos < bytes.size() && std::isspace(bytes[pos])) {
+            pos++;
+        }
+        while (pos < bytes.size() && !std::isspace(bytes[pos])) {
+            field += char(bytes[pos++]);
+        }
+    }
+    pos++;
+    if (fields[0] != "PF" || std::atof(fields[3].c_str()) >= 0) {
+        error = "not a little-endian color PFM";
+        return false;
+    }
+
+    int width = std::atoi(fields[1].c_str()), height = std::atoi(fields[2].c_str());
+    size_t row_bytes = size_t(width) * 3 * sizeof(float);
+    if (width <= 0 || height <= 0 || pos + row_bytes * height > bytes.size()) {
+        error = "truncated PFM";
+        return false;
+    }
+
+    image.resize(width, height);
+    for (int y = 0; y < height; y++) {
+        float* row = image.data() + size_t(height - 1 - y) * width * 3; // Rows are stored bottom-up.
+        std::memcpy(row, &bytes[pos + row_bytes * y], row_bytes); // Assumes a little-endian host.
+    }
+    return true;
+}
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,74 @@
+/***************************************************************
+* Description: Header file for the instance class, which draws *
+*              a shared object under an affine transform.      *
+***************************************************************/
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "transform.h"
+
+// Class placing a shared object (typically a triangle_mesh) in the world. Rays are moved into the
+// object's space instead of the object into the world, so any number of instances share one
+// copy of the geometry and its BVH. The direction is not renormalized, which keeps t the same in
+// both spaces.
+class instance : public hittable {
+public:
+    // Constructors:
+    instance(shared_ptr<hittable> object, const transform& object_to_world)
+      : object(std::move(object)), object_to_world(object_to_world), world_to_object(object_to_world.inverse()) {
+        bbox = object_to_world.box(this->object->bounding_box());
+    }
+
+    // Method to check for ray-object intersection with the transformed object.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!object->hit(to_object(r), ray_t, rec)) {
+            return false;
+        }
+        to_world(r, rec);
+        return true;
+    }
+
+    // Method to trace a packet of rays, transformed together into object space.
+    void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const override {
+        ray local[max_packet_size];
+        for (int k = 0; k < count; k++) {
+            local[k] = to_object(rays[k]);
+        }
+        object->hit_packet(local, count, ray_t, recs, hits);
+        for (int k = 0; k < count; k++) {
+            if (hits[k]) {
+                to_world(rays[k], recs[k]);
+            }
+        }
+    }
+
+    // Method to check whether the ray hits the transformed object at all.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        return object->any_hit(to_object(r), ray_t);
+    }
+
+    // Method returning the bounding box of the transformed object.
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    shared_ptr<hittable> object; // Object in its own space.
+    transform object_to_world; // Placement of the object.
+    transform world_to_object; // Inverse of the placement.
+    aabb bbox; // Bounding box in world space.
+
+    ray to_object(const ray& r) const {
+        return ray(world_to_object.point(r.origin()), world_to_object.vector(r.direction()));
+    }
+
+    // Move a hit found in object space back into world space. Normals transform with the
+    // inverse transpose; front_face carries over, since the transform keeps which side a ray is on.
+    void to_world(const ray& r, hit_record& rec) const {
+        rec.p = r.at(rec.t);
+        rec.normal = unit_vector(world_to_object.transpose_vector(rec.normal));
+    }
+};
+
+#endif // INSTANCE_H
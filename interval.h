@@ -3,43 +3,56 @@
 
 #include "rt_general.h" // Include necessary header files.
 
-// Class representing a closed interval [min, max].
-class interval {
+// Class template representing a closed interval [min, max] of values of type T.
+template <typename T>
+class basic_interval {
 public:
-    double min, max; // Minimum and maximum values of the interval.
+    T min, max; // Minimum and maximum values of the interval.
 
     // Constructors:
-    interval() : min(+infinity), max(-infinity) {} // Default constructor initializes interval to an empty state.
-    interval(double min, double max) : min(min), max(max) {} // Parameterized constructor.
+    basic_interval() : min(+infinity), max(-infinity) {} // Default constructor initializes interval to an empty state.
+    basic_interval(T min, T max) : min(min), max(max) {} // Parameterized constructor.
+    basic_interval(const basic_interval& a, const basic_interval& b) : min(std::fmin(a.min, b.min)), max(std::fmax(a.max, b.max)) {} // Tightest interval enclosing both.
 
     // Calculate the size of the interval.
-    double size() const {
+    T size() const {
         return max - min; // Difference between max and min.
     }
 
     // Check if the interval contains a given value.
-    bool contains(double x) const {
+    bool contains(T x) const {
         return min <= x && x <= max; // Check if x is within the interval bounds.
     }
 
     // Check if the interval surrounds a given value.
-    bool surrounds(double x) const {
+    bool surrounds(T x) const {
         return min < x && x < max; // Check if x is strictly within the interval bounds.
     }
 
     // Clamp a value to the interval bounds.
-    double clamp(double x) const {
+    T clamp(T x) const {
         if (x < min) return min; // Clamp x to min if it's less than min.
         if (x > max) return max; // Clamp x to max if it's greater than max.
         return x; // Otherwise, return x itself.
     }
 
+    // Return the interval padded by delta/2 on both ends.
+    basic_interval expand(T delta) const {
+        auto padding = delta / 2;
+        return basic_interval(min - padding, max + padding);
+    }
+
     // Static constants representing an empty and a universal interval.
-    static const interval empty, universe;
+    static const basic_interval empty, universe;
 };
 
 // Define static constants representing an empty interval and a universal interval.
-const interval interval::empty = interval(+infinity, -infinity);
-const interval interval::universe = interval(-infinity, +infinity);
+template <typename T>
+const basic_interval<T> basic_interval<T>::empty = basic_interval<T>(+infinity, -infinity);
+template <typename T>
+const basic_interval<T> basic_interval<T>::universe = basic_interval<T>(-infinity, +infinity);
+
+// Intervals in the precision the renderer was built with.
+using interval = basic_interval<real>;
 
-#endif // INTERVAL_H
\ No newline at end of file
+#endif // INTERVAL_H
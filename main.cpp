@@ -1,25 +1,535 @@
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include "rt_general.h"
 #include "hittable.h"
 #include "hittable_list.h"
 #include "sphere.h"
 #include "camera.h"
+#include "primitive_store.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "heatmap.h"
+#include "scene_file.h"
+#include "triangle_mesh.h"
+#include "instance.h"
+#include "obj_loader.h"
+#include "distributed.h"
+#include "progressive.h"
+#include "denoise.h"
+#include "batch.h"
+#include "animation.h"
+#include "preview.h"
 
 
+volatile std::sig_atomic_t stop_requested = 0; // Set by SIGINT / SIGTERM during a progressive render.
 
+// Ask a progressive render to stop after its current pass and checkpoint.
+extern "C" void request_stop(int) { stop_requested = 1; }
 
-int main() {
+// Print command line help.
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  -o, --output <path>       Output file, or - for standard output (default: -)\n"
+              << "  -f, --format <format>     ppm-ascii, ppm, png or pfm (default: from the file extension,\n"
+              << "                            plain-text ppm for standard output)\n"
+              << "  --adaptive <threshold>    Stop sampling pixels whose luminance standard error is below threshold\n"
+              << "  --packets <4|8>           Trace primary rays in packets of 4x4 or 8x8 pixels\n"
+              << "  --sampler <kind>          independent (default), stratified, sobol or blue-noise sample patterns\n"
+              << "  --engine <path|wavefront> Trace a path at a time (default) or waves of paths in stages\n"
+              << "  --ray-sort <order>        Ray order of the wavefront engine: direction (default), origin or none\n"
+              << "  --sample-map <path>       Write a heat-map of the samples spent per pixel\n"
+              << "  --stats <path>            Write render statistics (rays, tests, path lengths, tile times) as JSON\n"
+              << "  --cost-map <path>         Write a heat-map of the intersection tests spent per pixel\n"
+              << "                            (needs a build with RT_ENABLE_STATS)\n"
+              << "  --workers <n>             Split the frame across n worker processes\n"
+              << "  --split <tiles|samples>   Give workers ranges of tiles (default) or of samples per pixel\n"
+              << "  --spp <n>                 Samples per pixel\n"
+              << "  --checkpoint <path>       Render progressively in passes, saving the accumulated samples to path\n"
+              << "  --resume                  Continue from the checkpoint file if it exists (raise --spp to add samples,\n"
+              << "                            except with --sampler stratified)\n"
+              << "  --pass-samples <n>        Samples per pixel added by each progressive pass (default: 8)\n"
+              << "  --checkpoint-interval <s> Seconds between checkpoints (default: 60; the last pass always saves)\n"
+              << "  --denoise                 Denoise the image with the albedo, normal and depth of the first hits\n"
+              << "  --aov <prefix>            Write the auxiliary buffers to <prefix>albedo.pfm, normal.pfm and depth.pfm\n"
+              << "  --batch <path>            Render every camera job listed in path against the scene, then exit\n"
+              << "  --sequence <pattern>      Render the frames of an animated text scene to pattern, where #### becomes\n"
+              << "                            the frame number (e.g. frames/shot_####.png)\n"
+              << "  --frames <n>              Frames of the sequence (default: the scene's frames line)\n"
+              << "  --preview <ms>            Render as many passes as fit in the time budget, from low to full\n"
+              << "                            resolution (0 = refine up to --spp), and write that image\n"
+              << "  --stream <target>         Stream the preview's tiles as they finish to -, a file or named pipe,\n"
+              << "                            or unix:<socket path>\n"
+              << "  --interactive             Read camera changes from standard input during a preview, one line each\n"
+              << "                            (keywords as in --batch job files); each restarts the preview\n"
+              << "  --mesh <path.obj>         Put a triangle mesh from an OBJ file in place of the demo's center sphere\n"
+              << "  --scene <path>            Render a text or compiled scene file instead of the built-in demo\n"
+              << "  --compile-scene <in> <out>  Compile a text scene into a binary scene file and exit\n";
+}
 
-    hittable_list world;
 
-    world.add(make_shared<sphere>(point3(0,0,-1), 0.5));
-    world.add(make_shared<sphere>(point3(0,-100.5,-1),100));
+int main(int argc, char* argv[]) {
+
+    std::string output_path = "-"; // Where the image goes; "-" is standard output.
+    std::string format_name; // Explicit output format, if any.
+    double noise_threshold = 0; // Adaptive sampling threshold (0 = off).
+    int packet_size = 0; // Edge of primary ray packets (0 = single rays).
+    integrator engine = integrator::path; // How paths are traced.
+    sampler_kind sampler = sampler_kind::independent; // How samples choose their numbers.
+    ray_sort sort = ray_sort::direction; // Ray order of the wavefront engine.
+    std::string sample_map_path; // Where to write the samples-per-pixel heat-map, if anywhere.
+    std::string scene_path; // Scene file to render, if any.
+    std::string stats_path; // Where to write render statistics, if anywhere.
+    std::string cost_map_path; // Where to write the per-pixel cost heat-map, if anywhere.
+    std::string mesh_path; // OBJ mesh to show in the demo scene, if any.
+    distributed_options distribution; // Worker processes, if any.
+    bool distributed = false; // Render with worker processes.
+    int samples_per_pixel = 0; // Samples per pixel from the command line (0 = scene default).
+    progressive_options progression; // Passes and checkpoints of a progressive render.
+    bool resume = false; // Continue from an existing checkpoint.
+    bool denoise_image = false; // Denoise the rendered image.
+    std::string aov_prefix; // Where to write the auxiliary buffers, if anywhere.
+    std::string batch_path; // Camera job list to render, if any.
+    std::string sequence_pattern; // Image paths of an animated sequence, if rendering one.
+    int frame_count = 0; // Frames of the sequence (0 = as the scene says).
+    double preview_budget = -1; // Time budget of a preview in seconds (-1 = no preview, 0 = no limit).
+    std::string stream_target; // Where to stream preview tiles, if anywhere.
+    bool interactive = false; // Take camera changes from standard input during a preview.
+
+    // Parse command line options.
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            output_path = argv[++i];
+        }
+        else if ((arg == "-f" || arg == "--format") && i + 1 < argc) {
+            format_name = argv[++i];
+        }
+        else if (arg == "--adaptive" && i + 1 < argc) {
+            noise_threshold = std::atof(argv[++i]);
+        }
+        else if (arg == "--packets" && i + 1 < argc) {
+            packet_size = std::atoi(argv[++i]);
+        }
+        else if (arg == "--sampler" && i + 1 < argc) {
+            if (!parse_sampler_kind(argv[++i], sampler)) {
+                std::cerr << "Unknown sampler: " << argv[i] << '\n';
+                return 1;
+            }
+        }
+        else if (arg == "--engine" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name != "path" && name != "wavefront") {
+                std::cerr << "Unknown engine: " << name << '\n';
+                return 1;
+            }
+            engine = (name == "wavefront") ? integrator::wavefront : integrator::path;
+        }
+        else if (arg == "--ray-sort" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name != "direction" && name != "origin" && name != "none") {
+                std::cerr << "Unknown ray order: " << name << '\n';
+                return 1;
+            }
+            sort = (name == "origin") ? ray_sort::origin : (name == "none") ? ray_sort::none : ray_sort::direction;
+        }
+        else if (arg == "--sample-map" && i + 1 < argc) {
+            sample_map_path = argv[++i];
+        }
+        else if (arg == "--stats" && i + 1 < argc) {
+            stats_path = argv[++i];
+        }
+        else if (arg == "--cost-map" && i + 1 < argc) {
+            cost_map_path = argv[++i];
+        }
+        else if (arg == "--workers" && i + 1 < argc) {
+            distribution.workers = std::atoi(argv[++i]);
+            distributed = true;
+        }
+        else if (arg == "--split" && i + 1 < argc) {
+            std::string split = argv[++i];
+            if (split != "tiles" && split != "samples") {
+                std::cerr << "Unknown split: " << split << '\n';
+                return 1;
+            }
+            distribution.split = (split == "samples") ? split_mode::samples : split_mode::tiles;
+        }
+        else if (arg == "--spp" && i + 1 < argc) {
+            samples_per_pixel = std::atoi(argv[++i]);
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            progression.checkpoint_path = argv[++i];
+        }
+        else if (arg == "--resume") {
+            resume = true;
+        }
+        else if (arg == "--pass-samples" && i + 1 < argc) {
+            progression.pass_samples = std::atoi(argv[++i]);
+        }
+        else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            progression.checkpoint_seconds = std::atof(argv[++i]);
+        }
+        else if (arg == "--denoise") {
+            denoise_image = true;
+        }
+        else if (arg == "--aov" && i + 1 < argc) {
+            aov_prefix = argv[++i];
+        }
+        else if (arg == "--batch" && i + 1 < argc) {
+            batch_path = argv[++i];
+        }
+        else if (arg == "--sequence" && i + 1 < argc) {
+            sequence_pattern = argv[++i];
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            frame_count = std::atoi(argv[++i]);
+        }
+        else if (arg == "--preview" && i + 1 < argc) {
+            preview_budget = std::max(std::atof(argv[++i]), 0.0) / 1000;
+        }
+        else if (arg == "--stream" && i + 1 < argc) {
+            stream_target = argv[++i];
+        }
+        else if (arg == "--interactive") {
+            interactive = true;
+        }
+        else if (arg == "--mesh" && i + 1 < argc) {
+            mesh_path = argv[++i];
+        }
+        else if (arg == "--scene" && i + 1 < argc) {
+            scene_path = argv[++i];
+        }
+        else if (arg == "--compile-scene" && i + 2 < argc) {
+            std::string error;
+            if (!compile_scene_file(argv[i + 1], argv[i + 2], error)) {
+                std::cerr << error << '\n';
+                return 1;
+            }
+            return 0;
+        }
+        else {
+            print_usage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : 1;
+        }
+    }
+
+    image_format format = format_name.empty() ? image_format_from_path(output_path) : parse_image_format(format_name);
+    if (format == image_format::unknown) {
+        std::cerr << "Unknown image format: " << (format_name.empty() ? output_path : format_name) << '\n';
+        return 1;
+    }
+    for (const std::string* map_path : {&sample_map_path, &cost_map_path}) {
+        if (!map_path->empty() && image_format_from_path(*map_path) == image_format::unknown) {
+            std::cerr << "Unknown image format: " << *map_path << '\n';
+            return 1;
+        }
+    }
+    if (!cost_map_path.empty() && !stats_enabled) {
+        std::cerr << "--cost-map needs a build with RT_ENABLE_STATS (cmake -DRT_ENABLE_STATS=ON)\n";
+        return 1;
+    }
+
+    primitive_store<sphere> world;
+
+    if (mesh_path.empty()) {
+        world.emplace<sphere>(point3(0,0,-1), 0.5);
+    }
+    else {
+        mesh_buffers buffers;
+        std::string error;
+        if (!load_obj(mesh_path, buffers, error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        auto mesh = make_shared<triangle_mesh>(std::move(buffers));
+
+        // Scale the mesh to a unit box resting where the center sphere would be.
+        aabb box = mesh->bounding_box();
+        double extent = std::fmax(box.x.size(), std::fmax(box.y.size(), box.z.size()));
+        point3 center = box.centroid();
+        transform fit = transform::translate(point3(0, -0.5 + 0.5 * box.y.size() / extent, -1))
+                      * transform::scale(1 / extent)
+                      * transform::translate(-center);
+        world.emplace<instance>(mesh, fit);
+    }
+    world.emplace<sphere>(point3(0,-100.5,-1),100);
     camera cam;
-    
+
     cam.aspect_ratio = 16.0 / 9.0;
     cam.image_width = 400;
     cam.samples_per_pixel = 100;
     cam.max_depth = 50;
 
-    cam.render(world);
-}
\ No newline at end of file
+    // A scene file replaces the built-in world and camera settings. A sequence takes the motion
+    // from the text scene instead of a compiled still.
+    mapped_scene file_scene;
+    animation motion;
+    if (!sequence_pattern.empty()) {
+        scene_description description;
+        std::string error;
+        if (scene_path.empty() || is_compiled_scene_file(scene_path)) {
+            std::cerr << "--sequence needs a text scene (--scene) whose spheres have key lines\n";
+            return 1;
+        }
+        if (!read_scene_text(scene_path, description, error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        description.apply(cam);
+        make_animation(description, motion);
+    }
+    else if (!scene_path.empty()) {
+        std::string error;
+        if (!load_scene(scene_path, file_scene, error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        file_scene.apply(cam);
+    }
+
+    if (samples_per_pixel > 0) {
+        cam.samples_per_pixel = samples_per_pixel;
+    }
+    cam.adaptive_sampling = noise_threshold > 0;
+    cam.noise_threshold = noise_threshold;
+    cam.packet_size = packet_size;
+    cam.engine = engine;
+    cam.sampler = sampler;
+    cam.wavefront.sort = sort;
+
+    // A sequence renders its frames and exits.
+    if (!sequence_pattern.empty()) {
+        if (!batch_path.empty() || distributed || !progression.checkpoint_path.empty() || denoise_image || !aov_prefix.empty()
+            || !sample_map_path.empty() || !stats_path.empty() || !cost_map_path.empty()) {
+            std::cerr << "--sequence cannot be combined with --batch, --workers, --checkpoint, --denoise, --aov, --stats or the maps\n";
+            return 1;
+        }
+        if (frame_count > 0) {
+            motion.frame_count = frame_count;
+        }
+        motion.build();
+        sequence_options sequence;
+        sequence.output_pattern = sequence_pattern;
+        sequence.format = format_name.empty() ? image_format::unknown : format;
+        sequence_report report;
+        std::string error;
+        bool ok = render_sequence(motion, cam, sequence, report, error);
+        std::clog << report.frames << " frames, " << report.rays << " rays in " << report.seconds << " s ("
+                  << report.rays / report.seconds / 1e6 << " Mrays/s); moving objects placed in " << report.update_seconds
+                  << " s, " << report.refits << " refits, " << report.builds << " builds\n";
+        if (!ok) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    const hittable* scene = &file_scene; // The scene file already carries its BVH.
+    if (scene_path.empty()) {
+        world.build(); // Build the acceleration structure once for the whole render.
+        scene = &world;
+    }
+
+    // A batch renders its own list of cameras, which start from the settings above.
+    if (!batch_path.empty()) {
+        std::ifstream in(batch_path);
+        std::vector<render_job> jobs;
+        std::string error;
+        if (!in || !parse_batch_text(in, cam, jobs, error)) {
+            std::cerr << batch_path << ": " << (in ? error : "cannot open") << '\n';
+            return 1;
+        }
+        batch_report report;
+        bool ok = render_batch(jobs, *scene, batch_options(), report, error);
+        std::clog << report.frames << " frames, " << report.rays << " rays in " << report.seconds << " s ("
+                  << report.rays / report.seconds / 1e6 << " Mrays/s)\n";
+        if (!ok) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    // A preview renders what fits in its budget, streaming tiles as they finish, and writes that.
+    if (preview_budget >= 0) {
+        if (distributed || !progression.checkpoint_path.empty() || denoise_image || !aov_prefix.empty()
+            || !sample_map_path.empty() || !stats_path.empty() || !cost_map_path.empty()) {
+            std::cerr << "--preview cannot be combined with --workers, --checkpoint, --denoise, --aov, --stats or the maps\n";
+            return 1;
+        }
+        if (stream_target == "-" && output_path == "-") {
+            std::cerr << "--stream - needs the image to go to a file (-o)\n";
+            return 1;
+        }
+        preview_stream stream;
+        if (!stream_target.empty()) {
+            std::string error;
+            std::signal(SIGPIPE, SIG_IGN); // A viewer that goes away is a failed write, not the end of the process.
+            if (!stream.open(stream_target, error)) {
+                std::cerr << error << '\n';
+                return 1;
+            }
+        }
+        preview_options preview;
+        preview.budget_seconds = preview_budget;
+        preview_session session(*scene, preview, stream_target.empty() ? nullptr : &stream);
+        session.set_camera(cam);
+        if (interactive) {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                std::istringstream fields(line.substr(0, line.find('#')));
+                camera moved = cam;
+                std::string error;
+                if (!parse_camera_settings(fields, moved, error)) {
+                    std::cerr << "Camera change ignored: " << error << '\n';
+                    continue;
+                }
+                cam = moved;
+                session.set_camera(cam);
+            }
+        }
+        session.wait();
+
+        framebuffer image;
+        preview_report report;
+        session.latest(image, report);
+        std::clog << "Preview " << session.views() << ": " << report.passes << " passes, " << report.samples
+                  << " samples per pixel, " << report.rays << " rays in " << report.seconds << " s\n";
+        if (!write_image(output_path, format, image)) {
+            std::cerr << "Could not write " << output_path << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    framebuffer image;
+    std::vector<int> samples_taken; // Samples per pixel, for the sample map.
+    cam.record_aovs = denoise_image || !aov_prefix.empty();
+    if (cam.record_aovs && (distributed || !progression.checkpoint_path.empty())) {
+        std::cerr << "--denoise and --aov are not available with --workers or --checkpoint\n";
+        return 1;
+    }
+    if (distributed) {
+        if (!stats_path.empty() || !cost_map_path.empty()) {
+            std::cerr << "--stats and --cost-map are not available with --workers\n";
+            return 1;
+        }
+        accumulation_buffer sums;
+        distributed_report report;
+        std::string error;
+        if (!render_distributed(cam, *scene, distribution, sums, report, error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        sums.resolve(image);
+        samples_taken = sums.sample_counts();
+        std::clog << report.rays << " rays in " << report.seconds << " s (" << report.rays / report.seconds / 1e6
+                  << " Mrays/s) on " << distribution.workers << " workers, " << report.jobs << " ranges";
+        if (report.lost_workers > 0) {
+            std::clog << ", workers lost: " << report.lost_workers;
+        }
+        std::clog << '\n';
+    }
+    else if (!progression.checkpoint_path.empty()) {
+        if (distributed || cam.adaptive_sampling || !stats_path.empty() || !cost_map_path.empty()) {
+            std::cerr << "--checkpoint cannot be combined with --workers, --adaptive, --stats or --cost-map\n";
+            return 1;
+        }
+        render_checkpoint state;
+        std::string error;
+        if (resume && std::ifstream(progression.checkpoint_path)) {
+            if (!load_checkpoint(progression.checkpoint_path, state, error)) {
+                std::cerr << error << '\n';
+                return 1;
+            }
+            std::clog << "Resuming at " << state.samples_done << " samples per pixel\n";
+        }
+        else {
+            state.reset(cam);
+        }
+
+        std::signal(SIGINT, request_stop); // Preemption: finish the pass, checkpoint and write the image.
+        std::signal(SIGTERM, request_stop);
+        progression.after_pass = [&](const render_checkpoint& progress) {
+            std::clog << "Pass done: " << progress.samples_done << " of " << cam.samples_per_pixel << " samples per pixel\n";
+            return !stop_requested;
+        };
+        progressive_report report;
+        if (!render_progressive(cam, *scene, progression, state, report, error)) {
+            std::cerr << error << '\n';
+            return 1;
+        }
+        state.sums.resolve(image);
+        samples_taken = state.sums.sample_counts();
+        std::clog << report.rays << " rays in " << report.seconds << " s over " << report.passes << " passes";
+        if (report.stopped) {
+            std::clog << ", stopped at " << state.samples_done << " samples per pixel";
+        }
+        std::clog << '\n';
+    }
+    else {
+        cam.render(*scene, image);
+        samples_taken = cam.samples_taken();
+        std::clog << cam.rays_traced() << " rays in " << cam.seconds() << " s (" << cam.rays_per_second() / 1e6
+                  << " Mrays/s), average path length " << cam.average_path_length() << '\n';
+    }
+
+    if (!aov_prefix.empty()) {
+        const aov_buffers& aovs = cam.aovs();
+        framebuffer depth(aovs.width(), aovs.height());
+        for (int y = 0; y < depth.height(); y++) {
+            for (int x = 0; x < depth.width(); x++) {
+                float z = aovs.depth[size_t(y) * depth.width() + x];
+                depth.set(x, y, color(z, z, z));
+            }
+        }
+        if (!write_image(aov_prefix + "albedo.pfm", image_format::pfm, aovs.albedo) ||
+            !write_image(aov_prefix + "normal.pfm", image_format::pfm, aovs.normal) ||
+            !write_image(aov_prefix + "depth.pfm", image_format::pfm, depth)) {
+            std::cerr << "Could not write the auxiliary buffers to " << aov_prefix << "*.pfm\n";
+            return 1;
+        }
+    }
+    if (denoise_image) {
+        framebuffer noisy = image;
+        denoise(noisy, cam.aovs(), image);
+    }
+
+    if (!write_image(output_path, format, image)) {
+        std::cerr << "Could not write " << output_path << '\n';
+        return 1;
+    }
+
+    if (cam.adaptive_sampling) {
+        double total = 0;
+        for (int n : samples_taken) {
+            total += n;
+        }
+        std::clog << "Average samples per pixel: " << total / samples_taken.size() << '\n';
+    }
+    if (!sample_map_path.empty()) {
+        framebuffer sample_map = make_heatmap(samples_taken, image.width(), image.height(), cam.samples_per_pixel);
+        if (!write_image(sample_map_path, image_format_from_path(sample_map_path), sample_map)) {
+            std::cerr << "Could not write " << sample_map_path << '\n';
+            return 1;
+        }
+    }
+    if (!stats_path.empty()) {
+        std::ofstream out(stats_path);
+        cam.write_stats(out);
+        if (!out) {
+            std::cerr << "Could not write " << stats_path << '\n';
+            return 1;
+        }
+    }
+    if (!cost_map_path.empty()) {
+        framebuffer cost_map = make_heatmap(cam.pixel_cost(), image.width(), image.height());
+        if (!write_image(cost_map_path, image_format_from_path(cost_map_path), cost_map)) {
+            std::cerr << "Could not write " << cost_map_path << '\n';
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,153 @@
+/***************************************************************
+* Description: Header file for the Wavefront OBJ loader, which *
+*              streams a file into triangle mesh buffers.      *
+***************************************************************/
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "triangle_mesh.h"
+
+#include <cstdint> // Include necessary standard library headers.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Parse one OBJ line (without its newline) into the buffers. Only positions ("v") and faces
+// ("f") are read; texture coordinates, normals, groups and materials are skipped. Faces with more
+// than three corners are split into a fan. Returns false and sets error on a malformed line.
+inline bool parse_obj_line(const char* line, const char* end, mesh_buffers& out, std::string& error) {
+    while (line < end && (*line == ' ' || *line == '\t')) {
+        line++;
+    }
+    if (end - line < 2 || (line[1] != ' ' && line[1] != '\t')) {
+        return true; // Empty line, comment, or a statement we do not read ("vt", "vn", "usemtl", ...).
+    }
+
+    char* next;
+    if (line[0] == 'v') {
+        const char* p = line + 1;
+        for (int k = 0; k < 3; k++) {
+            double value = std::strtod(p, &next); // strtod skips the leading whitespace itself.
+            if (next == p) {
+                error = "bad vertex";
+                return false;
+            }
+            out.positions.push_back(real(value));
+            p = next;
+        }
+        return true;
+    }
+
+    if (line[0] == 'f') {
+        long vertex_count = long(out.vertex_count());
+        uint32_t first = 0, previous = 0;
+        int corners = 0;
+        const char* p = line + 1;
+        while (true) {
+            long index = std::strtol(p, &next, 10);
+            if (next == p) {
+                break; // No more corners.
+            }
+            if (index < 0) {
+                index += vertex_count + 1; // Negative indices count back from the last vertex.
+            }
+            if (index < 1 || index > vertex_count) {
+                error = "face index out of range";
+                return false;
+            }
+            p = next;
+            while (p < end && *p != ' ' && *p != '\t') {
+                p++; // Skip "/vt/vn".
+            }
+
+            uint32_t v = uint32_t(index - 1);
+            if (corners == 0) {
+                first = v;
+            }
+            else if (corners >= 2) {
+                out.indices.push_back(first);
+                out.indices.push_back(previous);
+                out.indices.push_back(v);
+            }
+            previous = v;
+            corners++;
+        }
+        if (corners < 3) {
+            error = "face with fewer than three corners";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Load the triangles of an OBJ file. The file is read in fixed-size chunks and parsed line by
+// line, so memory stays at the size of the resulting buffers (12 bytes per float vertex, 12 per
+// triangle) even for files of many millions of triangles. Returns false and sets error on failure.
+inline bool load_obj(const std::string& path, mesh_buffers& out, std::string& error) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    out = mesh_buffers();
+
+    std::vector<char> buffer(1 << 20);
+    size_t filled = 0; // Bytes in buffer, starting with the tail of the previous chunk.
+    long line_number = 1;
+    bool ok = true;
+    while (ok) {
+        size_t n = std::fread(buffer.data() + filled, 1, buffer.size() - filled - 1, file);
+        bool at_end = (n == 0);
+        filled += n;
+        if (at_end && filled == 0) {
+            break;
+        }
+        if (at_end) {
+            buffer[filled++] = '\n'; // Terminate a last line without a newline.
+        }
+
+        const char* begin = buffer.data();
+        const char* stop = begin + filled;
+        const char* line = begin;
+        while (ok) {
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', size_t(stop - line)));
+            if (!newline) {
+                break;
+            }
+            const char* end = (newline > line && newline[-1] == '\r') ? newline - 1 : newline;
+            *const_cast<char*>(end) = '\0'; // strtod and strtol stop at the end of the line.
+            ok = parse_obj_line(line, end, out, error);
+            if (!ok) {
+                error = path + ":" + std::to_string(line_number) + ": " + error;
+            }
+            line_number++;
+            line = newline + 1;
+        }
+
+        filled = size_t(stop - line); // Keep the unfinished line for the next chunk.
+        std::memmove(buffer.data(), line, filled);
+        if (filled + 1 >= buffer.size()) {
+            buffer.resize(buffer.size() * 2); // A single line longer than the buffer.
+        }
+    }
+    if (ok && std::ferror(file)) {
+        error = "cannot read " + path;
+        ok = false;
+    }
+    std::fclose(file);
+    if (ok && out.indices.empty()) {
+        error = path + ": no faces";
+        ok = false;
+    }
+    if (ok && out.vertex_count() > UINT32_MAX) {
+        error = path + ": too many vertices";
+        ok = false;
+    }
+    return ok;
+}
+
+#endif // OBJ_LOADER_H
@@ -0,0 +1,391 @@
+/***************************************************************
+* Description: Header file for preview rendering: progressive *
+*              passes from low to full resolution within a     *
+*              time budget, streamed tile by tile to a viewer, *
+*              and restarted whenever the camera changes.      *
+***************************************************************/
+
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "camera.h"
+#include "accumulation.h"
+#include "framebuffer.h"
+#include "thread_pool.h"
+#include "distributed.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h> // POSIX headers for files and sockets.
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Kinds of preview stream messages.
+enum class preview_message_type : uint32_t {
+    view = 1, // A new view starts (the camera changed); width and height give its image size.
+    tile = 2, // A finished tile of a pass; its pixels follow the message.
+    pass = 3, // A pass finished: every tile of it has been sent.
+    done = 4 // The view's preview is finished, cancelled or out of time.
+};
+
+constexpr uint32_t preview_cancelled = 1; // done flag: a camera change cut the view short.
+
+// Header of a preview stream message, in host byte order. A tile message is followed by the
+// tile's pixels: (x1 - x0) * (y1 - y0) linear RGB triples of float, row by row.
+struct preview_message {
+    char magic[4]; // "RTPV".
+    uint32_t type; // A preview_message_type.
+    uint32_t view; // Number of the view; every camera change starts the next one.
+    int32_t scale; // Full-resolution pixels per pass pixel along each axis (1 = full resolution).
+    int32_t width, height; // Image size of the view (view, done), or of the pass (tile, pass).
+    int32_t x0, y0, x1, y1; // Rectangle of a tile within its pass image.
+    int32_t samples; // Samples per pixel in the tile or pass, or at full resolution when done.
+    uint32_t flags; // done: preview_cancelled, if set.
+    double seconds; // Time since the view started.
+};
+
+// Where a preview is streamed: standard output, a file or named pipe, or a Unix-domain socket
+// that a viewer listens on. Messages may be sent from several threads at once; once the viewer
+// goes away, further messages are dropped and the preview carries on.
+class preview_stream {
+public:
+    preview_stream() {}
+    preview_stream(const preview_stream&) = delete;
+    preview_stream& operator=(const preview_stream&) = delete;
+    ~preview_stream() { close(); }
+
+    // Open a target: "-" for standard output, "unix:<path>" to connect to a socket, or a path to
+    // create (a file) or open (a named pipe). Returns false and sets error on failure. Writing to
+    // a pipe whose reader is gone raises SIGPIPE; ignore it in a program that streams to pipes.
+    bool open(const std::string& target, std::string& error) {
+        close();
+        if (target == "-") {
+            fd = STDOUT_FILENO;
+            owned = false;
+        }
+        else if (target.rfind("unix:", 0) == 0) {
+            std::string path = target.substr(5);
+            sockaddr_un address;
+            std::memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+                error = "bad socket path " + path;
+                return false;
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size());
+            fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+                close();
+                error = "cannot connect to " + path;
+                return false;
+            }
+            socket = true;
+        }
+        else {
+            fd = ::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                error = "cannot open " + target;
+                return false;
+            }
+        }
+        failed = false;
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0 && owned) {
+            ::close(fd);
+        }
+        fd = -1;
+        owned = true;
+        socket = false;
+    }
+
+    // Whether messages still reach the viewer.
+    bool is_open() const { return fd >= 0 && !failed; }
+
+    // Send a message, followed by count floats of pixels.
+    void send(const preview_message& message, const float* pixels = nullptr, size_t count = 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fd < 0 || failed) {
+            return;
+        }
+        failed = !write_all(&message, sizeof(message)) || !write_all(pixels, count * sizeof(float));
+    }
+
+private:
+    int fd = -1; // Descriptor written to (-1 = closed).
+    bool owned = true; // Close fd when done (not standard output).
+    bool socket = false; // fd is a socket.
+    bool failed = false; // A write failed; the viewer is gone.
+    std::mutex mutex; // Keeps messages whole when threads send at once.
+
+    bool write_all(const void* data, size_t size) {
+        if (socket) {
+            return send_all(fd, data, size);
+        }
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            p += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+};
+
+// Settings of a preview.
+struct preview_options {
+    double budget_seconds = 0.2; // Wall-clock time per view (0 = refine up to samples_per_pixel).
+    int first_scale = 8; // Pixel size of the first, coarsest pass; each further coarse pass halves it.
+    int pass_samples = 1; // Samples per pixel added by each full-resolution pass.
+};
+
+// What a preview of one view did.
+struct preview_report {
+    int passes = 0; // Passes finished, coarse and full resolution.
+    int samples = 0; // Samples per pixel of the full-resolution passes finished.
+    uint64_t rays = 0; // Rays traced.
+    double seconds = 0; // Wall-clock time.
+    bool cancelled = false; // *cancel cut the preview short.
+};
+
+// Render a preview of one view within options.budget_seconds. Coarse passes of one sample per
+// pixel come first, at 1/first_scale of the resolution, then twice as fine, up to half resolution;
+// then full-resolution passes add options.pass_samples samples per pixel each until the budget is
+// spent or every pixel holds cam.samples_per_pixel. Once time is up or *cancel is set (say, the
+// camera moved), the pass stops after the tiles being rendered. Every finished tile and pass is
+// sent to stream, if given, as soon as it is done, with the mean of all full-resolution samples
+// its pixels hold so far. Full-resolution samples are those of a normal render, so a preview
+// that runs to the end is the normal image. image receives the preview: full-resolution pixels
+// where they have samples, the finest coarse pass elsewhere.
+inline void render_preview(camera cam, const hittable& world, const preview_options& options, uint32_t view,
+                           const std::atomic<bool>& cancel, preview_stream* stream, framebuffer& image,
+                           preview_report& report) {
+    report = preview_report();
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    std::atomic<bool> stop{false}; // Ends the current pass: cancelled or out of time.
+    auto should_stop = [&] {
+        if (cancel.load(std::memory_order_relaxed) || (options.budget_seconds > 0 && elapsed() >= options.budget_seconds)) {
+            stop.store(true, std::memory_order_relaxed);
+        }
+        return stop.load(std::memory_order_relaxed);
+    };
+
+    cam.adaptive_sampling = false; // Passes take fixed sample ranges, as in progressive rendering.
+    cam.record_aovs = false;
+    cam.show_progress = false;
+    cam.cancel = &stop;
+    const int width = cam.image_width, height = cam.frame_height();
+
+    auto send = [&](preview_message_type type, int scale, int w, int h, int samples, uint32_t flags) {
+        if (stream) {
+            preview_message message = {{'R', 'T', 'P', 'V'}, uint32_t(type), view, scale, w, h, 0, 0, 0, 0, samples, flags, elapsed()};
+            stream->send(message);
+        }
+    };
+    // Send the mean of total plus pass over a tile.
+    auto send_tile = [&](int scale, const accumulation_buffer& total, const accumulation_buffer& pass,
+                         int samples, int x0, int y0, int x1, int y1) {
+        if (!stream) {
+            return;
+        }
+        std::vector<float> pixels;
+        pixels.reserve(size_t(x1 - x0) * (y1 - y0) * 3);
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                int n = pass.count(x, y) + (total.width() > 0 ? total.count(x, y) : 0);
+                color sum = pass.sum(x, y) + (total.width() > 0 ? total.sum(x, y) : color(0, 0, 0));
+                color mean = (n > 0) ? (1.0 / n) * sum : color(0, 0, 0);
+                pixels.insert(pixels.end(), {float(mean.x()), float(mean.y()), float(mean.z())});
+            }
+        }
+        preview_message message = {{'R', 'T', 'P', 'V'}, uint32_t(preview_message_type::tile), view, scale,
+                                   pass.width(), pass.height(), x0, y0, x1, y1, samples, 0, elapsed()};
+        stream->send(message, pixels.data(), pixels.size());
+    };
+
+    send(preview_message_type::view, 1, width, height, 0, 0);
+
+    // Coarse passes: one sample per pixel at a fraction of the resolution.
+    accumulation_buffer coarse, pass; // Finest finished coarse pass, and the pass being rendered.
+    const accumulation_buffer none; // Empty sums: coarse passes start from nothing.
+    for (int scale = std::max(options.first_scale, 1); scale > 1 && !should_stop(); scale /= 2) {
+        camera small = cam;
+        small.image_width = std::max(width / scale, 1);
+        small.samples_per_pixel = 1;
+        small.on_tile = [&](int x0, int y0, int x1, int y1) {
+            send_tile(scale, none, pass, 1, x0, y0, x1, y1);
+            should_stop();
+        };
+        small.render(world, render_range(), pass);
+        report.rays += small.rays_traced();
+        if (small.interrupted()) {
+            break;
+        }
+        coarse = pass;
+        report.passes++;
+        send(preview_message_type::pass, scale, pass.width(), pass.height(), 1, 0);
+    }
+
+    // Full-resolution passes, accumulated as in progressive rendering.
+    accumulation_buffer total(width, height);
+    while (report.samples < cam.samples_per_pixel && !should_stop()) {
+        int end = std::min(report.samples + std::max(options.pass_samples, 1), cam.samples_per_pixel);
+        render_range range;
+        range.sample_begin = report.samples;
+        range.sample_end = end;
+        cam.on_tile = [&](int x0, int y0, int x1, int y1) {
+            send_tile(1, total, pass, end, x0, y0, x1, y1);
+            should_stop();
+        };
+        cam.render(world, range, pass);
+        report.rays += cam.rays_traced();
+        total.merge(pass); // A stopped pass still adds the tiles it finished.
+        if (cam.interrupted()) {
+            break;
+        }
+        report.samples = end;
+        report.passes++;
+        send(preview_message_type::pass, 1, width, height, end, 0);
+    }
+
+    // The preview image: full-resolution pixels, or the coarse pass where there are none yet.
+    total.resolve(image);
+    if (coarse.width() > 0) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (total.count(x, y) == 0) {
+                    int cx = std::min(x * coarse.width() / width, coarse.width() - 1);
+                    int cy = std::min(y * coarse.height() / height, coarse.height() - 1);
+                    if (coarse.count(cx, cy) > 0) {
+                        image.set(x, y, (1.0 / coarse.count(cx, cy)) * coarse.sum(cx, cy));
+                    }
+                }
+            }
+        }
+    }
+    report.cancelled = cancel.load();
+    report.seconds = elapsed();
+    send(preview_message_type::done, 1, width, height, report.samples, report.cancelled ? preview_cancelled : 0);
+}
+
+// Keeps previewing a changing camera on a background thread: every set_camera() cancels the view
+// being rendered, which stops after its current tiles, and starts a preview of the new one. Views
+// follow each other strictly, so a viewer never sees tiles of two views interleaved.
+class preview_session {
+public:
+    // world must outlive the session; thread_count counts the background thread.
+    preview_session(const hittable& world, const preview_options& options, preview_stream* stream = nullptr, int thread_count = 0)
+      : world(world), options(options), stream(stream), pool(thread_count), worker([this] { run(); }) {}
+
+    preview_session(const preview_session&) = delete;
+    preview_session& operator=(const preview_session&) = delete;
+
+    ~preview_session() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+            cancel = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    // Show a new view: cancel the current one and preview cam instead.
+    void set_camera(const camera& cam) {
+        std::lock_guard<std::mutex> lock(mutex);
+        next = cam;
+        has_next = true;
+        cancel = true;
+        changed.notify_all();
+    }
+
+    // Wait until the latest view's preview is finished (or out of time).
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return !busy && !has_next; });
+    }
+
+    // The preview of the last view that finished, and its report.
+    void latest(framebuffer& image, preview_report& report) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        image = last_image;
+        report = last_report;
+    }
+
+    // Number of views started so far.
+    uint32_t views() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return view_count;
+    }
+
+private:
+    const hittable& world; // Scene shown.
+    preview_options options; // Budget and passes of every view.
+    preview_stream* stream; // Where tiles go, if anywhere.
+    thread_pool pool; // Render threads, shared by all views.
+
+    mutable std::mutex mutex; // Guards the fields below.
+    std::condition_variable changed; // Signalled when a camera arrives or the session ends.
+    std::condition_variable finished; // Signalled when a view is done.
+    camera next; // Camera of the next view.
+    bool has_next = false; // next is waiting to be shown.
+    bool busy = false; // A view is being rendered.
+    bool quitting = false; // The session is shutting down.
+    std::atomic<bool> cancel{false}; // Cancels the view being rendered.
+    uint32_t view_count = 0;
+    framebuffer last_image;
+    preview_report last_report;
+
+    std::thread worker; // Background thread rendering the views; started last.
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [&] { return has_next || quitting; });
+            if (quitting) {
+                return;
+            }
+            camera cam = next;
+            cam.pool = &pool;
+            has_next = false;
+            busy = true;
+            cancel = false;
+            uint32_t view = ++view_count;
+            lock.unlock();
+
+            framebuffer image;
+            preview_report report;
+            render_preview(cam, world, options, view, cancel, stream, image, report);
+
+            lock.lock();
+            last_image = std::move(image);
+            last_report = report;
+            busy = false;
+            finished.notify_all();
+        }
+    }
+};
+
+#endif // PREVIEW_H
@@ -0,0 +1,150 @@
+/***************************************************************
+* Description: Header file for the primitive_store class, a    *
+*              scene container that keeps each primitive type  *
+*              in its own contiguous array and BVH.            *
+***************************************************************/
+
+#ifndef PRIMITIVE_STORE_H
+#define PRIMITIVE_STORE_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "bvh.h"
+#include "arena.h"
+
+#include <tuple> // Include necessary standard library headers.
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Class holding a scene's primitives sorted by type. Each type in Types is stored by value in its
+// own array and gets its own BVH, whose leaves call the type's hit() directly, so the innermost
+// loop has no pointer chasing and no virtual calls. Any other hittable can still be added: it
+// goes to a shared_ptr BVH, allocated from the store's arena when created with emplace().
+// Add primitives, then call build() before rendering.
+template <typename... Types>
+class primitive_store : public hittable {
+public:
+    // Constructors:
+    primitive_store() {}
+
+    // Add a copy of a primitive, by value if its type is one of Types.
+    template <typename T>
+    void add(const T& primitive) {
+        emplace<T>(primitive);
+    }
+
+    // Add any hittable through a pointer (the extension point for custom types).
+    void add(shared_ptr<hittable> object) {
+        pending_others.push_back(std::move(object));
+    }
+
+    // Construct a primitive in place: in its type's array if it is one of Types, otherwise in
+    // the arena.
+    template <typename T, typename... Args>
+    void emplace(Args&&... args) {
+        if constexpr ((std::is_same<T, Types>::value || ...)) {
+            std::get<std::vector<T>>(pending).emplace_back(std::forward<Args>(args)...);
+        }
+        else {
+            pending_others.push_back(arena.make<T>(std::forward<Args>(args)...));
+        }
+    }
+
+    // Build the BVHs over everything added so far (including the primitives of an earlier build).
+    void build(const bvh_build_options& options = bvh_build_options()) {
+        build_tree(trees_of_others, pending_others, options);
+        bbox = trees_of_others.bounding_box();
+        build_trees(options, std::index_sequence_for<Types...>());
+    }
+
+    // Number of primitives, built or not.
+    size_t size() const {
+        size_t n = trees_of_others.primitives().size() + pending_others.size();
+        for_each_type([&](const auto& tree, const auto& staged) { n += tree.primitives().size() + staged.size(); });
+        return n;
+    }
+
+    // Method to check for ray-object intersection with every built primitive.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        bool hit_anything = false;
+        auto hit_tree = [&](const hittable& tree) {
+            if (tree.hit(r, ray_t, rec)) {
+                hit_anything = true;
+                ray_t.max = rec.t; // Later trees only need to find closer hits.
+            }
+        };
+        for_each_type([&](const auto& tree, const auto&) { hit_tree(tree); });
+        hit_tree(trees_of_others);
+        return hit_anything;
+    }
+
+    // Method to trace a packet of rays, one tree after the other; the closest hit per ray wins.
+    void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const override {
+        for (int k = 0; k < count; k++) {
+            hits[k] = false;
+        }
+        hit_record tree_recs[max_packet_size];
+        bool tree_hits[max_packet_size];
+        auto hit_tree = [&](const hittable& tree) {
+            tree.hit_packet(rays, count, ray_t, tree_recs, tree_hits);
+            for (int k = 0; k < count; k++) {
+                if (tree_hits[k] && (!hits[k] || tree_recs[k].t < recs[k].t)) {
+                    hits[k] = true;
+                    recs[k] = tree_recs[k];
+                }
+            }
+        };
+        for_each_type([&](const auto& tree, const auto&) { hit_tree(tree); });
+        hit_tree(trees_of_others);
+    }
+
+    // Method to check whether the ray hits any built primitive.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        bool found = false;
+        for_each_type([&](const auto& tree, const auto&) { found = found || tree.any_hit(r, ray_t); });
+        return found || trees_of_others.any_hit(r, ray_t);
+    }
+
+    // Method returning the bounding box of the built primitives.
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    std::tuple<std::vector<Types>...> pending; // Primitives added since the last build, per type.
+    std::tuple<basic_bvh<Types>...> trees; // One BVH per type.
+    std::vector<shared_ptr<hittable>> pending_others; // Other hittables added since the last build.
+    bvh trees_of_others; // BVH over the other hittables.
+    object_arena arena; // Storage for other hittables created with emplace().
+    aabb bbox; // Bounding box of everything built.
+
+    // Call f(tree, pending primitives) for every type, in the order of Types.
+    template <typename F>
+    void for_each_type(F&& f) const {
+        for_each_type(f, std::index_sequence_for<Types...>());
+    }
+
+    template <typename F, size_t... I>
+    void for_each_type(F& f, std::index_sequence<I...>) const {
+        (f(std::get<I>(trees), std::get<I>(pending)), ...);
+    }
+
+    template <size_t... I>
+    void build_trees(const bvh_build_options& options, std::index_sequence<I...>) {
+        ((build_tree(std::get<I>(trees), std::get<I>(pending), options),
+          bbox = aabb(bbox, std::get<I>(trees).bounding_box())), ...);
+    }
+
+    // Rebuild one tree over its current primitives plus the pending ones.
+    template <typename Primitive>
+    static void build_tree(basic_bvh<Primitive>& tree, std::vector<Primitive>& staged, const bvh_build_options& options) {
+        if (staged.empty()) {
+            return;
+        }
+        std::vector<Primitive> all = tree.primitives();
+        all.insert(all.end(), std::make_move_iterator(staged.begin()), std::make_move_iterator(staged.end()));
+        staged.clear();
+        tree = basic_bvh<Primitive>(std::move(all), options);
+    }
+};
+
+#endif // PRIMITIVE_STORE_H
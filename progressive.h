@@ -0,0 +1,219 @@
+/***************************************************************
+* Description: Header file for progressive rendering: samples  *
+*              are added in passes and the accumulated state   *
+*              is checkpointed to disk so renders can resume.  *
+***************************************************************/
+
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "camera.h"
+#include "accumulation.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Everything needed to continue a progressive render: the sample sums so far, the next sample
+// index and the settings they were taken with. Samples draw from streams keyed on (seed, pixel,
+// sample index), so the next sample index is the whole random state.
+struct render_checkpoint {
+    uint64_t seed = 0; // Frame seed.
+    int32_t width = 0, height = 0; // Frame size.
+    int32_t max_depth = 0; // Path settings that change the image.
+    int32_t russian_roulette = 0, rr_min_depth = 0;
+    int32_t sampler = 0; // Sampler kind; its patterns decide which numbers a sample index gets.
+    int32_t samples_done = 0; // Every pixel holds the samples [0, samples_done).
+    int32_t sample_count = 0; // Samples per pixel the render was started for (the stratified sampler's strata).
+    accumulation_buffer sums; // Sample sums and counts so far.
+
+    // Start a new render with the camera's settings.
+    void reset(const camera& cam) {
+        seed = cam.seed;
+        width = cam.image_width;
+        height = cam.frame_height();
+        max_depth = cam.max_depth;
+        russian_roulette = cam.russian_roulette;
+        rr_min_depth = cam.rr_min_depth;
+        sampler = int32_t(cam.sampler);
+        samples_done = 0;
+        sample_count = cam.samples_per_pixel;
+        sums.resize(width, height);
+    }
+
+    // Check whether the samples so far were taken with the camera's settings.
+    bool matches(const camera& cam) const {
+        return seed == cam.seed && width == cam.image_width && height == cam.frame_height() && max_depth == cam.max_depth &&
+               russian_roulette == int32_t(cam.russian_roulette) && rr_min_depth == cam.rr_min_depth &&
+               sampler == int32_t(cam.sampler) && strata_match(cam);
+    }
+
+    // The stratified sampler lays its strata out for the frame's samples per pixel, so more samples
+    // on top would mix two stratifications; such a render resumes only with the count it started with.
+    // The other samplers' samples do not depend on the count.
+    bool strata_match(const camera& cam) const {
+        return sampler != int32_t(sampler_kind::stratified) || sample_count == cam.samples_per_pixel;
+    }
+};
+
+constexpr char checkpoint_magic[8] = {'R', 'T', 'C', 'K', 'P', 'T', '0', '3'}; // Checkpoint file signature.
+
+// Write a checkpoint. The file is written next to path and renamed over it once complete, so a
+// render stopped while saving leaves the previous checkpoint intact. Returns false and sets error
+// on failure.
+inline bool save_checkpoint(const std::string& path, const render_checkpoint& state, std::string& error) {
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        error = "cannot write " + temporary;
+        return false;
+    }
+    int32_t header[8] = {state.width, state.height, state.max_depth, state.russian_roulette, state.rr_min_depth, state.samples_done, state.sampler, state.sample_count};
+    size_t pixels = size_t(state.width) * state.height;
+    bool ok = std::fwrite(checkpoint_magic, sizeof(checkpoint_magic), 1, file) == 1 &&
+              std::fwrite(&state.seed, sizeof(state.seed), 1, file) == 1 &&
+              std::fwrite(header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(state.sums.sum_data(), sizeof(double), 3 * pixels, file) == 3 * pixels &&
+              std::fwrite(state.sums.count_data(), sizeof(int), pixels, file) == pixels;
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+// Read a checkpoint written by save_checkpoint. Returns false and sets error on failure.
+inline bool load_checkpoint(const std::string& path, render_checkpoint& state, std::string& error) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    char magic[sizeof(checkpoint_magic)];
+    int32_t header[8] = {};
+    bool ok = std::fread(magic, sizeof(magic), 1, file) == 1 &&
+         std::memcmp(magic, checkpoint_magic, sizeof(magic)) == 0 &&
+         std::fread(&state.seed, sizeof(state.seed), 1, file) == 1 &&
+         std::fread(header, sizeof(header), 1, file) == 1 &&
+         header[0] > 0 && header[1] > 0 && header[5] >= 0 && header[7] > 0;
+    if (ok) {
+        // The rest of the file must be exactly the sums and counts of width x height pixels; check
+        // before allocating, so a corrupt size is reported instead of attempting a huge allocation.
+        long payload_begin = std::ftell(file);
+        ok = payload_begin >= 0 && std::fseek(file, 0, SEEK_END) == 0;
+        long payload_end = ok ? std::ftell(file) : -1;
+        const uint64_t pixel_bytes = 3 * sizeof(double) + sizeof(int);
+        uint64_t payload = uint64_t(payload_end - payload_begin);
+        ok = ok && payload_end >= payload_begin && std::fseek(file, payload_begin, SEEK_SET) == 0 &&
+             payload % pixel_bytes == 0 && payload / pixel_bytes == uint64_t(header[0]) * uint64_t(header[1]);
+    }
+    if (ok) {
+        state.width = header[0];
+        state.height = header[1];
+        state.max_depth = header[2];
+        state.russian_roulette = header[3];
+        state.rr_min_depth = header[4];
+        state.samples_done = header[5];
+        state.sampler = header[6];
+        state.sample_count = header[7];
+
+        size_t pixels = size_t(state.width) * state.height;
+        std::vector<double> sums(3 * pixels);
+        std::vector<int> counts(pixels);
+        ok = std::fread(sums.data(), sizeof(double), 3 * pixels, file) == 3 * pixels &&
+             std::fread(counts.data(), sizeof(int), pixels, file) == pixels;
+        if (ok) {
+            state.sums.resize(state.width, state.height);
+            state.sums.merge_rows(0, state.height, sums.data(), counts.data());
+        }
+    }
+    std::fclose(file);
+    if (!ok) {
+        error = path + " is not a complete checkpoint";
+    }
+    return ok;
+}
+
+// Settings of a progressive render.
+struct progressive_options {
+    int pass_samples = 8; // Samples per pixel added by each pass.
+    std::string checkpoint_path; // Where to save checkpoints (empty = never).
+    double checkpoint_seconds = 60; // Save at the end of the first pass this long after the last save.
+
+    // Called after every pass with the state so far; returning false stops the render after
+    // saving a checkpoint (e.g. once the image is good enough, or when the job is preempted).
+    std::function<bool(const render_checkpoint&)> after_pass;
+};
+
+// What a progressive render did.
+struct progressive_report {
+    int passes = 0; // Passes rendered in this run.
+    uint64_t rays = 0; // Rays traced in this run.
+    double seconds = 0; // Wall-clock time of this run.
+    bool stopped = false; // after_pass ended the render before samples_per_pixel was reached.
+};
+
+// Render progressively: continue state (reset() it to start afresh) in passes of
+// options.pass_samples until every pixel holds cam.samples_per_pixel samples, saving checkpoints
+// along the way and at the end. Raise samples_per_pixel to add samples to a finished render
+// (except with the stratified sampler, whose strata are fixed when the render starts).
+// Adaptive sampling decides per pixel when to stop and is not used. Returns false and sets error
+// if state belongs to other settings or a checkpoint cannot be written.
+inline bool render_progressive(camera& cam, const hittable& world, const progressive_options& options,
+                               render_checkpoint& state, progressive_report& report, std::string& error) {
+    if (!state.strata_match(cam)) {
+        error = "the checkpoint's stratified samples are laid out for " + std::to_string(state.sample_count) +
+                " samples per pixel; resume it with that many, or start afresh for more";
+        return false;
+    }
+    if (!state.matches(cam)) {
+        error = "the checkpoint was rendered with another seed, image size, sampler or path settings";
+        return false;
+    }
+    report = progressive_report();
+    auto start = std::chrono::steady_clock::now();
+    auto last_save = start;
+    bool adaptive = cam.adaptive_sampling;
+    cam.adaptive_sampling = false;
+
+    accumulation_buffer pass; // Sums of the current pass.
+    bool ok = true;
+    while (ok && state.samples_done < cam.samples_per_pixel) {
+        render_range range;
+        range.sample_begin = state.samples_done;
+        range.sample_end = std::min(state.samples_done + std::max(options.pass_samples, 1), cam.samples_per_pixel);
+        cam.render(world, range, pass);
+        state.sums.merge(pass);
+        state.samples_done = range.sample_end;
+        report.passes++;
+        report.rays += cam.rays_traced();
+
+        bool keep_going = !options.after_pass || options.after_pass(state);
+        auto now = std::chrono::steady_clock::now();
+        bool finished = !keep_going || state.samples_done >= cam.samples_per_pixel;
+        if (!options.checkpoint_path.empty() &&
+            (finished || std::chrono::duration<double>(now - last_save).count() >= options.checkpoint_seconds)) {
+            ok = save_checkpoint(options.checkpoint_path, state, error);
+            last_save = now;
+        }
+        if (!keep_going) {
+            report.stopped = true;
+            break;
+        }
+    }
+
+    cam.adaptive_sampling = adaptive;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
+#endif // PROGRESSIVE_H
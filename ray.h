@@ -3,25 +3,31 @@
 
 #include "vec3.h" // Include necessary header files.
 
-// Class representing a ray in 3D space.
-class ray { 
+// Class template representing a ray in 3D space with components of type T.
+template <typename T>
+class basic_ray {
 public:
+    using point = basic_vec3<T>; // Point and vector type of the ray.
+
     // Constructors:
-    ray() {} // Default constructor.
-    ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {} // Parameterized constructor.
+    basic_ray() {} // Default constructor.
+    basic_ray(const point& origin, const point& direction) : orig(origin), dir(direction) {} // Parameterized constructor.
 
     // Accessor functions for ray properties:
-    const point3& origin() const { return orig; } // Return immutable reference to the origin.
-    const vec3& direction() const { return dir; } // Return immutable reference to the direction.
-    
+    const point& origin() const { return orig; } // Return immutable reference to the origin.
+    const point& direction() const { return dir; } // Return immutable reference to the direction.
+
     // Compute the position of the ray at a given parameter value t.
-    point3 at(double t) const {
+    point at(T t) const {
         return orig + t * dir; // Compute position using ray equation.
     }
 
 private:
-    point3 orig; // Origin point of the ray.
-    vec3 dir; // Direction vector of the ray.
+    point orig; // Origin point of the ray.
+    point dir; // Direction vector of the ray.
 };
 
-#endif // RAY_H
\ No newline at end of file
+// Rays in the precision the renderer was built with.
+using ray = basic_ray<real>;
+
+#endif // RAY_H
@@ -0,0 +1,60 @@
+/***************************************************************
+* Description: Header file for the rng class, a small PCG32    *
+*              random number generator that can be seeded per  *
+*              pixel and per sample for reproducible renders.  *
+***************************************************************/
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint> // Include necessary standard library headers.
+
+// Mix a 64-bit value into a well-scrambled 64-bit hash (SplitMix64 finalizer).
+inline uint64_t mix_bits(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Class representing a PCG32 generator (64-bit LCG state, permuted 32-bit output). It is eight
+// bytes of state plus a stream selector, so one can be created for every pixel sample.
+class rng {
+public:
+    // Constructors:
+    rng() : rng(0, 0) {} // Default constructor uses seed 0 on stream 0.
+
+    // Generator for a given seed on a given stream; different streams never overlap.
+    rng(uint64_t seed, uint64_t stream) {
+        state = 0;
+        inc = (stream << 1) | 1; // The increment must be odd.
+        next_uint();
+        state += seed;
+        next_uint();
+    }
+
+    // Generator for one sample of one pixel of a frame. The same triple always gives the same
+    // sequence, no matter which thread or process draws it, or in which order samples are taken.
+    rng(uint64_t frame_seed, uint64_t pixel_index, uint64_t sample_index)
+      : rng(mix_bits(frame_seed ^ mix_bits(sample_index)), pixel_index) {}
+
+    // Generate the next 32 random bits.
+    uint32_t next_uint() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc; // Advance the LCG.
+        uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u); // Permute the old state.
+        uint32_t rot = uint32_t(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    // Generate a random double in the range [0, 1).
+    double next_double() {
+        return next_uint() * 0x1.0p-32;
+    }
+
+private:
+    uint64_t state; // LCG state.
+    uint64_t inc; // Stream selector (always odd).
+};
+
+#endif // RNG_H
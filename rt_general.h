@@ -7,19 +7,34 @@
 #define RT_GENERAL_H
 
 #include <cmath> // Include necessary standard libraries.
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <memory>
 
+#include "rng.h" // Random number generator used by the helpers below.
+
 // Std Usings
 using std::make_shared; 
 using std::shared_ptr;
 using std::sqrt;
 
+// Scalar type of the math core (vectors, rays, intervals, hit records), chosen at build time.
+#ifdef RT_USE_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
 // Constants
 const double infinity = std::numeric_limits<double>::infinity(); // Define infinity constant.
 const double pi = 3.1415926535897932385; // Define pi constant.
 
+// Closest distance at which a bounced ray may hit a surface. Hit points carry rounding error and
+// can land just inside the surface they left, so the bounce would hit it again (shadow acne).
+// Float needs this margin; double uses the same one so both precisions render the same scene.
+const real bounce_t_min = real(0.001);
+
 // Utility functions
 
 // Convert degrees to radians.
@@ -27,14 +42,29 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180; // Formula to convert degrees to radians.
 }
 
+// Generator used by the random helpers when no explicit rng is passed. It is per thread, so
+// render threads never share (or race on) a generator.
+inline rng& thread_rng() {
+    thread_local rng generator;
+    return generator;
+}
+
 // Generate a random double in the range [0, 1).
+inline double random_double(rng& gen) {
+    return gen.next_double();
+}
+
 inline double random_double() {
-    return rand() / (RAND_MAX + 1.0); // Generate a random double using rand() function.
+    return random_double(thread_rng());
 }
 
 // Generate a random double in the specified range [min, max).
+inline double random_double(rng& gen, double min, double max) {
+    return min + (max - min) * random_double(gen); // Generate a random double within the specified range.
+}
+
 inline double random_double(double min, double max) {
-    return min + (max - min) * random_double(); // Generate a random double within the specified range.
+    return random_double(thread_rng(), min, max);
 }
 
 // Headers
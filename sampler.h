@@ -0,0 +1,331 @@
+/***************************************************************
+* Description: Header file for pixel samplers: the numbers a   *
+*              camera sample uses for its pixel position and   *
+*              each bounce, from independent random draws to   *
+*              stratified, Sobol and blue-noise patterns.      *
+***************************************************************/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rt_general.h" // Include necessary header files.
+
+#include <algorithm> // Include necessary standard library headers.
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How a camera sample's numbers are chosen.
+enum class sampler_kind {
+    independent, // Independent uniform draws from the sample's random stream (the original sampler).
+    stratified, // Each dimension's square or interval is split into samples_per_pixel cells, one sample per cell.
+    sobol, // Owen-scrambled Sobol points, each pair of dimensions scrambled independently per pixel.
+    blue_noise // A Sobol sequence shared by all pixels, shifted per pixel by a blue-noise tile.
+};
+
+// Parse and name sampler kinds as on the command line. Returns false for unknown names.
+inline bool parse_sampler_kind(const std::string& name, sampler_kind& kind) {
+    if (name == "independent") kind = sampler_kind::independent;
+    else if (name == "stratified") kind = sampler_kind::stratified;
+    else if (name == "sobol") kind = sampler_kind::sobol;
+    else if (name == "blue-noise") kind = sampler_kind::blue_noise;
+    else return false;
+    return true;
+}
+
+inline const char* sampler_name(sampler_kind kind) {
+    switch (kind) {
+        case sampler_kind::stratified: return "stratified";
+        case sampler_kind::sobol: return "sobol";
+        case sampler_kind::blue_noise: return "blue-noise";
+        default: return "independent";
+    }
+}
+
+// Hash two values into 32 well-mixed bits.
+inline uint32_t sample_hash(uint64_t a, uint64_t b) {
+    return uint32_t(mix_bits(a ^ mix_bits(b)));
+}
+
+// Reverse the order of the bits of x.
+inline uint32_t reverse_bits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Hash in which each bit depends only on the seed and the bits below it (Laine-Karras style, with
+// the constants of Burley, "Practical Hash-based Owen Scrambling", JCGT 2020, revised 2021).
+// Applied to bit-reversed values it is an Owen scramble: each bit is flipped or not depending on
+// the seed and the bits above it.
+inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return x;
+}
+
+// Owen scrambling of the bits of x.
+inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+// The first two dimensions of the Sobol sequence, as 32-bit fixed-point fractions.
+inline uint32_t sobol_0(uint32_t index) {
+    return reverse_bits(index); // The van der Corput sequence.
+}
+
+// The second dimension, bit-reversed. Its generator matrix is applied a byte at a time through
+// tables; the last entry of each row holds the table's byte position.
+inline uint32_t sobol_1_reversed(uint32_t index) {
+    struct byte_tables {
+        uint32_t rows[4][256];
+        byte_tables() {
+            uint32_t columns[32]; // Reversed direction numbers: v_0 = 1 << 31, v_k = v_(k-1) ^ (v_(k-1) >> 1).
+            for (uint32_t k = 0, v = 1u << 31; k < 32; k++, v ^= v >> 1) {
+                columns[k] = reverse_bits(v);
+            }
+            for (int b = 0; b < 4; b++) {
+                for (uint32_t byte = 0; byte < 256; byte++) {
+                    uint32_t result = 0;
+                    for (int bit = 0; bit < 8; bit++) {
+                        if (byte & (1u << bit)) {
+                            result ^= columns[8 * b + bit];
+                        }
+                    }
+                    rows[b][byte] = result;
+                }
+            }
+        }
+    };
+    static const byte_tables tables;
+    return tables.rows[0][index & 255] ^ tables.rows[1][(index >> 8) & 255] ^
+           tables.rows[2][(index >> 16) & 255] ^ tables.rows[3][index >> 24];
+}
+
+inline uint32_t sobol_1(uint32_t index) {
+    return reverse_bits(sobol_1_reversed(index));
+}
+
+// A pseudo-random permutation of [0, n), chosen by seed: the image of i (Kensler, "Correlated
+// Multi-Jittered Sampling", 2013). Values past n are walked back into range.
+inline uint32_t permute_index(uint32_t i, uint32_t n, uint32_t seed) {
+    uint32_t w = n - 1;
+    w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+    do {
+        i ^= seed; i *= 0xe170893du; i ^= seed >> 16; i ^= (i & w) >> 4;
+        i ^= seed >> 8; i *= 0x0929eb3fu; i ^= seed >> 23; i ^= (i & w) >> 1;
+        i *= 1 | seed >> 27; i *= 0x6935fa69u; i ^= (i & w) >> 11; i *= 0x74dcb303u;
+        i ^= (i & w) >> 2; i *= 0x9e501cc3u; i ^= (i & w) >> 2; i *= 0xc860a3dfu;
+        i &= w; i ^= i >> 5;
+    } while (i >= n);
+    return (i + seed) % n;
+}
+
+constexpr int blue_noise_size = 64; // Edge of the blue-noise tile in pixels.
+
+// Build a blue-noise tile with the void-and-cluster method (Ulichney 1993): a value per pixel
+// whose every threshold gives evenly spread pixels, with no low-frequency clumps. Pixel energy is
+// a Gaussian of the toroidal distance to the chosen pixels; the initial pattern is relaxed by
+// moving its tightest cluster to its largest void, ranked by removing clusters, and then the
+// largest voids are filled in until every pixel has a rank.
+inline std::vector<float> make_blue_noise_tile() {
+    const int size = blue_noise_size, n = size * size;
+    const double sigma = 1.5;
+    std::vector<double> kernel(n); // Energy added at each toroidal offset from a chosen pixel.
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            int dx = std::min(x, size - x), dy = std::min(y, size - y);
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+        }
+    }
+    auto splat = [&](std::vector<double>& energy, int index, double sign) {
+        int px = index % size, py = index / size;
+        for (int y = 0; y < size; y++) {
+            const double* row = &kernel[((y - py + size) % size) * size];
+            for (int x = 0; x < size; x++) {
+                energy[y * size + x] += sign * row[(x - px + size) % size];
+            }
+        }
+    };
+    auto extreme = [&](const std::vector<double>& energy, const std::vector<char>& on, bool chosen, bool highest) {
+        int best = -1;
+        for (int i = 0; i < n; i++) {
+            if (bool(on[i]) == chosen && (best < 0 || (highest ? energy[i] > energy[best] : energy[i] < energy[best]))) {
+                best = i;
+            }
+        }
+        return best;
+    };
+
+    // Initial pattern: a tenth of the pixels at random, relaxed until it is evenly spread.
+    std::vector<double> energy(n, 0.0);
+    std::vector<char> on(n, 0);
+    rng gen(0xb1e5, 0);
+    int initial = n / 10;
+    for (int placed = 0; placed < initial;) {
+        int i = int(gen.next_uint() % uint32_t(n));
+        if (!on[i]) {
+            on[i] = 1;
+            splat(energy, i, 1);
+            placed++;
+        }
+    }
+    while (true) {
+        int cluster = extreme(energy, on, true, true);
+        on[cluster] = 0;
+        splat(energy, cluster, -1);
+        int hole = extreme(energy, on, false, false);
+        on[hole] = 1;
+        splat(energy, hole, 1);
+        if (hole == cluster) {
+            break; // Moving any pixel would not spread the pattern further.
+        }
+    }
+
+    // Rank the initial pixels by taking out clusters, then the rest by filling voids.
+    std::vector<int> rank(n);
+    std::vector<double> removing = energy;
+    std::vector<char> remaining = on;
+    for (int r = initial - 1; r >= 0; r--) {
+        int cluster = extreme(removing, remaining, true, true);
+        remaining[cluster] = 0;
+        splat(removing, cluster, -1);
+        rank[cluster] = r;
+    }
+    for (int r = initial; r < n; r++) {
+        int hole = extreme(energy, on, false, false);
+        on[hole] = 1;
+        splat(energy, hole, 1);
+        rank[hole] = r;
+    }
+
+    std::vector<float> tile(n);
+    for (int i = 0; i < n; i++) {
+        tile[i] = (rank[i] + 0.5f) / n;
+    }
+    return tile;
+}
+
+// The blue-noise tile, built on first use.
+inline const std::vector<float>& blue_noise_tile() {
+    static const std::vector<float> tile = make_blue_noise_tile();
+    return tile;
+}
+
+// Class handing out the numbers of one camera sample, dimension by dimension: the pixel position
+// takes the first pair, then every bounce its own. Each dimension (or pair) of each pixel gets its
+// own scramble or permutation, so the dimensions are not correlated with each other. Numbers are
+// in [0, 1) and uniformly distributed, whatever the kind, so estimates stay unbiased. Past the
+// patterns' reach (samples beyond samples_per_pixel for the stratified kind) it falls back to
+// independent draws.
+class pixel_sampler {
+public:
+    // Constructors:
+    pixel_sampler() {}
+
+    // Sampler for sample sample_index of pixel (x, y) in a frame of sample_count samples per pixel.
+    pixel_sampler(sampler_kind kind, uint64_t seed, int x, int y, uint64_t pixel_index, uint32_t sample_index, uint32_t sample_count)
+      : gen(seed, pixel_index, sample_index), kind(kind), index(sample_index), count(sample_count),
+        pixel_seed(kind == sampler_kind::blue_noise ? uint32_t(seed) : sample_hash(seed, pixel_index)),
+        columns(kind == sampler_kind::stratified ? grid_columns(count) : 1),
+        tile_x(uint8_t(x % blue_noise_size)), tile_y(uint8_t(y % blue_noise_size)) {}
+
+    // The next dimension.
+    double get_1d() {
+        uint32_t seed = sample_hash(pixel_seed, dimension++);
+        switch (kind) {
+            case sampler_kind::stratified:
+                if (index >= count) {
+                    break;
+                }
+                return (permute_index(index, count, seed) + gen.next_double()) / count;
+            case sampler_kind::sobol:
+                return to_unit(reverse_bits(laine_karras_permutation(shuffled_index(seed), seed ^ 0x9e3779b9u)));
+            case sampler_kind::blue_noise:
+                return shift(to_unit(reverse_bits(laine_karras_permutation(shuffled_index(seed), seed ^ 0x9e3779b9u))), seed);
+            default:
+                break;
+        }
+        return gen.next_double();
+    }
+
+    // The next pair of dimensions, as a point of the unit square.
+    void get_2d(double& u1, double& u2) {
+        uint32_t seed = sample_hash(pixel_seed, dimension++);
+        switch (kind) {
+            case sampler_kind::stratified:
+                if (index < count) {
+                    uint32_t cell = permute_index(index, count, seed);
+                    u1 = (cell % columns + gen.next_double()) / columns;
+                    u2 = (cell / columns + gen.next_double()) / (count / columns);
+                    return;
+                }
+                break;
+            case sampler_kind::sobol:
+            case sampler_kind::blue_noise: {
+                // Owen-scrambled Sobol point of an Owen-shuffled index; scrambling works on reversed
+                // bits, and the first dimension reversed is the index itself.
+                uint32_t i = shuffled_index(seed);
+                u1 = to_unit(reverse_bits(laine_karras_permutation(i, seed ^ 0x9e3779b9u)));
+                u2 = to_unit(reverse_bits(laine_karras_permutation(sobol_1_reversed(i), seed ^ 0x7f4a7c15u)));
+                if (kind == sampler_kind::blue_noise) {
+                    u1 = shift(u1, seed);
+                    u2 = shift(u2, seed ^ 0x85ebca6bu);
+                }
+                return;
+            }
+            default:
+                break;
+        }
+        u1 = gen.next_double(); // Drawn in a fixed order so results do not depend on the compiler.
+        u2 = gen.next_double();
+    }
+
+    // The sample's own random stream, for anything that is not sampled dimension by dimension.
+    rng& random() { return gen; }
+
+    sampler_kind type() const { return kind; }
+
+private:
+    rng gen; // Random stream of the sample: all the independent kind draws, and jitter.
+    sampler_kind kind = sampler_kind::independent;
+    uint32_t index = 0; // Sample index within the pixel.
+    uint32_t count = 1; // Samples per pixel of the frame.
+    uint32_t pixel_seed = 0; // Scramble seed of the pixel (of the frame, for blue noise).
+    uint32_t dimension = 0; // Next dimension (pairs count as one).
+    uint32_t columns = 1; // The stratified grid has columns x (count / columns) cells.
+    uint8_t tile_x = 0, tile_y = 0; // Position in the blue-noise tile.
+
+    static double to_unit(uint32_t bits) { return bits * 0x1.0p-32; }
+
+    // The sample index shuffled by an Owen scramble, so each dimension pair visits the Sobol points
+    // in its own order; any aligned power-of-two run of indices still covers a run of points.
+    uint32_t shuffled_index(uint32_t seed) const { return nested_uniform_scramble(index, seed); }
+
+    // Columns of the stratified grid for n cells: the largest divisor of n up to sqrt(n), so the
+    // grid is as square as n allows and every cell is used.
+    static uint32_t grid_columns(uint32_t n) {
+        uint32_t columns = uint32_t(std::sqrt(double(n)));
+        while (columns > 1 && n % columns != 0) {
+            columns--;
+        }
+        return columns < 1 ? 1 : columns;
+    }
+
+    // Toroidal shift of u by the pixel's value in the blue-noise tile, read at an offset chosen by
+    // seed so that each dimension sees a different (uncorrelated) part of the tile.
+    double shift(double u, uint32_t seed) const {
+        int x = (tile_x + int(seed & 63)) % blue_noise_size, y = (tile_y + int((seed >> 6) & 63)) % blue_noise_size;
+        double v = u + blue_noise_tile()[y * blue_noise_size + x];
+        return v >= 1 ? v - 1 : v;
+    }
+};
+
+#endif // SAMPLER_H
@@ -0,0 +1,587 @@
+/***************************************************************
+* Description: Header file for scene files: a text scene       *
+*              description, and a compiled binary format that  *
+*              is memory-mapped and traced without copying.    *
+***************************************************************/
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "bvh.h"
+#include "camera.h"
+#include "batch.h"
+#include "sphere_set.h"
+
+#include <cstdio> // Include necessary standard library headers.
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Position of a moving sphere at a key frame.
+struct sphere_key {
+    size_t sphere; // Index of the sphere in scene_description::sphere_centers.
+    double frame; // Frame of the key.
+    point3 center; // Center of the sphere at that frame.
+};
+
+// Class holding a scene as read from a text description: camera settings plus primitives.
+class scene_description {
+public:
+    double aspect_ratio = 16.0 / 9.0; // Camera settings, as in the camera class.
+    int image_width = 400;
+    int samples_per_pixel = 100;
+    int max_depth = 50;
+    uint64_t seed = 0;
+    point3 lookfrom = point3(0, 0, 0); // Camera placement, as in the camera class.
+    point3 lookat = point3(0, 0, -1);
+    vec3 vup = vec3(0, 1, 0);
+    double vfov = 90;
+
+    std::vector<point3> sphere_centers; // Sphere primitives.
+    std::vector<double> sphere_radii;
+
+    int frame_count = 1; // Frames of the animated sequence.
+    std::vector<sphere_key> sphere_keys; // Key positions of the moving spheres.
+
+    // Copy the camera settings onto a camera.
+    void apply(camera& cam) const {
+        cam.aspect_ratio = aspect_ratio;
+        cam.image_width = image_width;
+        cam.samples_per_pixel = samples_per_pixel;
+        cam.max_depth = max_depth;
+        cam.seed = seed;
+        cam.lookfrom = lookfrom;
+        cam.lookat = lookat;
+        cam.vup = vup;
+        cam.vfov = vfov;
+    }
+
+    // Take the camera settings back from a camera (the inverse of apply).
+    void take(const camera& cam) {
+        aspect_ratio = cam.aspect_ratio;
+        image_width = cam.image_width;
+        samples_per_pixel = cam.samples_per_pixel;
+        max_depth = cam.max_depth;
+        seed = cam.seed;
+        lookfrom = cam.lookfrom;
+        lookat = cam.lookat;
+        vup = cam.vup;
+        vfov = cam.vfov;
+    }
+};
+
+// Parse a text scene. Each line is a keyword followed by its values; '#' starts a comment:
+//
+//     aspect_ratio 1.7778          image_width 400       samples_per_pixel 100
+//     max_depth 50                 seed 0
+//     lookfrom 0 1 1               lookat 0 0 -1         vup 0 1 0        vfov 60
+//     sphere <x> <y> <z> <radius>
+//
+// A line starting with a placement keyword (lookfrom, lookat, vup, vfov) is read like the camera
+// settings of a batch job (parse_camera_settings), so it may carry several; the view they give
+// together is checked once the whole scene is read.
+//
+// Animated scenes also give a frame count, and key positions for the spheres that move; each key
+// line belongs to the sphere above it. Still renders and compiled scenes leave spheres where the
+// sphere line puts them:
+//
+//     frames 48
+//     sphere 0 0 -1 0.5
+//     key 0 -1 0 -1
+//     key 47 1 0 -1
+//
+// Returns false and sets error on malformed input.
+inline bool parse_scene_text(std::istream& in, scene_description& scene, std::string& error) {
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        auto hash = line.find('#');
+        if (hash != std::string::npos) {
+            line.erase(hash); // Strip comments.
+        }
+
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword)) {
+            continue; // Blank line.
+        }
+
+        bool ok = true;
+        if (keyword == "sphere") {
+            double x, y, z, radius;
+            ok = bool(fields >> x >> y >> z >> radius);
+            if (ok) {
+                scene.sphere_centers.push_back(point3(x, y, z));
+                scene.sphere_radii.push_back(fmax(0, radius));
+            }
+        }
+        else if (keyword == "key") {
+            double frame, x, y, z;
+            ok = bool(fields >> frame >> x >> y >> z) && !scene.sphere_centers.empty();
+            if (ok) {
+                scene.sphere_keys.push_back({scene.sphere_centers.size() - 1, frame, point3(x, y, z)});
+            }
+        }
+        else if (keyword == "lookfrom" || keyword == "lookat" || keyword == "vup" || keyword == "vfov") {
+            std::istringstream settings(line); // The keyword and its values, as a batch job gives them.
+            camera cam;
+            scene.apply(cam);
+            std::string setting_error;
+            if (!parse_camera_settings(settings, cam, setting_error, false)) {
+                error = "line " + std::to_string(line_number) + ": " + setting_error;
+                return false;
+            }
+            scene.take(cam);
+        }
+        else if (keyword == "frames") ok = bool(fields >> scene.frame_count) && scene.frame_count > 0;
+        else if (keyword == "aspect_ratio") ok = bool(fields >> scene.aspect_ratio) && scene.aspect_ratio > 0;
+        else if (keyword == "image_width") ok = bool(fields >> scene.image_width) && scene.image_width > 0;
+        else if (keyword == "samples_per_pixel") ok = bool(fields >> scene.samples_per_pixel) && scene.samples_per_pixel > 0;
+        else if (keyword == "max_depth") ok = bool(fields >> scene.max_depth) && scene.max_depth >= 0;
+        else if (keyword == "seed") ok = bool(fields >> scene.seed);
+        else {
+            error = "line " + std::to_string(line_number) + ": unknown keyword '" + keyword + "'";
+            return false;
+        }
+
+        if (!ok) {
+            error = "line " + std::to_string(line_number) + ": bad values for '" + keyword + "'";
+            return false;
+        }
+    }
+    camera view;
+    scene.apply(view);
+    return check_camera_view(view, error);
+}
+
+// Read a text scene file. Returns false and sets error if it cannot be read or parsed.
+inline bool read_scene_text(const std::string& path, scene_description& scene, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!parse_scene_text(in, scene, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+// Header of a compiled scene file. All arrays start at 64-byte aligned offsets, so they can be
+// used straight from a memory mapping. Numbers are stored in host (little-endian) byte order.
+struct scene_file_header {
+    char magic[8]; // "RTSCENE" plus a terminating zero.
+    uint32_t version; // Format version.
+    uint32_t endian_check; // 0x01020304 as written by the host.
+    double aspect_ratio; // Camera settings.
+    int32_t image_width;
+    int32_t samples_per_pixel;
+    int32_t max_depth;
+    int32_t reserved;
+    uint64_t seed;
+    double lookfrom[3], lookat[3], vup[3]; // Camera placement.
+    double vfov;
+    uint64_t sphere_count; // Number of spheres, stored in BVH leaf order.
+    uint64_t node_count; // Number of BVH nodes.
+    uint64_t spheres_offset; // Offset of the x, y, z and radius arrays (sphere_count doubles each).
+    uint64_t nodes_offset; // Offset of the bvh_node array.
+    uint64_t file_size; // Total size, for validation.
+};
+
+const char scene_file_magic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', 0};
+const uint32_t scene_file_version = 2;
+
+// Round an offset up to the next multiple of 64.
+inline uint64_t align_to_64(uint64_t offset) {
+    return (offset + 63) & ~uint64_t(63);
+}
+
+// Compile a scene into the binary layout: builds the BVH and stores spheres in leaf order.
+inline std::vector<unsigned char> compile_scene(const scene_description& scene, const bvh_build_options& options = bvh_build_options()) {
+    size_t n = scene.sphere_centers.size();
+    std::vector<aabb> boxes(n);
+    for (size_t i = 0; i < n; i++) {
+        auto rvec = vec3(scene.sphere_radii[i], scene.sphere_radii[i], scene.sphere_radii[i]);
+        boxes[i] = aabb(scene.sphere_centers[i] - rvec, scene.sphere_centers[i] + rvec);
+    }
+    std::vector<int> order;
+    std::vector<bvh_node> nodes = bvh_builder(boxes, options).build(order);
+
+    scene_file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, scene_file_magic, sizeof(header.magic));
+    header.version = scene_file_version;
+    header.endian_check = 0x01020304;
+    header.aspect_ratio = scene.aspect_ratio;
+    header.image_width = scene.image_width;
+    header.samples_per_pixel = scene.samples_per_pixel;
+    header.max_depth = scene.max_depth;
+    header.seed = scene.seed;
+    for (int k = 0; k < 3; k++) {
+        header.lookfrom[k] = scene.lookfrom[k];
+        header.lookat[k] = scene.lookat[k];
+        header.vup[k] = scene.vup[k];
+    }
+    header.vfov = scene.vfov;
+    header.sphere_count = n;
+    header.node_count = nodes.size();
+    header.spheres_offset = align_to_64(sizeof(header));
+    header.nodes_offset = align_to_64(header.spheres_offset + 4 * n * sizeof(double));
+    header.file_size = header.nodes_offset + nodes.size() * sizeof(bvh_node);
+
+    std::vector<unsigned char> bytes(header.file_size, 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    double* arrays = reinterpret_cast<double*>(bytes.data() + header.spheres_offset);
+    for (size_t k = 0; k < n; k++) {
+        const point3& c = scene.sphere_centers[order[k]];
+        arrays[k] = c.x();
+        arrays[n + k] = c.y();
+        arrays[2 * n + k] = c.z();
+        arrays[3 * n + k] = scene.sphere_radii[order[k]];
+    }
+    if (!nodes.empty()) {
+        std::memcpy(bytes.data() + header.nodes_offset, nodes.data(), nodes.size() * sizeof(bvh_node));
+    }
+    return bytes;
+}
+
+// Class representing a compiled scene used in place: sphere arrays and BVH nodes are read directly
+// from a memory-mapped file (or an in-memory buffer), without parsing or rebuilding anything.
+class mapped_scene : public hittable {
+public:
+    mapped_scene() {}
+    mapped_scene(const mapped_scene&) = delete;
+    mapped_scene& operator=(const mapped_scene&) = delete;
+    ~mapped_scene() { close(); }
+
+    // Map a compiled scene file. Returns false and sets error if it is missing or invalid.
+    bool open(const std::string& path, std::string& error) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "cannot open " + path;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            error = "cannot read " + path;
+            return false;
+        }
+        void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping stays valid after the descriptor is closed.
+        if (mapping == MAP_FAILED) {
+            error = "cannot map " + path;
+            return false;
+        }
+        mapped = mapping;
+        mapped_size = size_t(st.st_size);
+        return attach(static_cast<const unsigned char*>(mapped), mapped_size, error);
+#else
+        std::ifstream in(path, std::ios::binary); // No mmap here: read the file in one go instead.
+        if (!in) {
+            error = "cannot open " + path;
+            return false;
+        }
+        return open(std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()), error);
+#endif
+    }
+
+    // Use a compiled scene held in memory (e.g. straight from compile_scene).
+    bool open(const std::vector<unsigned char>& bytes, std::string& error) {
+        close();
+        owned.resize((bytes.size() + 63) / 64); // Copy into 64-byte aligned storage, like a mapping.
+        std::memcpy(owned.data(), bytes.data(), bytes.size());
+        return attach(reinterpret_cast<const unsigned char*>(owned.data()), bytes.size(), error);
+    }
+
+    // Release the mapping or buffer.
+    void close() {
+#ifndef _WIN32
+        if (mapped) {
+            munmap(mapped, mapped_size);
+        }
+#endif
+        mapped = nullptr;
+        mapped_size = 0;
+        owned.clear();
+        header = nullptr;
+    }
+
+    // Copy the stored camera settings onto a camera.
+    void apply(camera& cam) const {
+        cam.aspect_ratio = header->aspect_ratio;
+        cam.image_width = header->image_width;
+        cam.samples_per_pixel = header->samples_per_pixel;
+        cam.max_depth = header->max_depth;
+        cam.seed = header->seed;
+        cam.lookfrom = point3(header->lookfrom[0], header->lookfrom[1], header->lookfrom[2]);
+        cam.lookat = point3(header->lookat[0], header->lookat[1], header->lookat[2]);
+        cam.vup = vec3(header->vup[0], header->vup[1], header->vup[2]);
+        cam.vfov = header->vfov;
+    }
+
+    // Number of spheres in the scene.
+    size_t sphere_count() const { return header ? size_t(header->sphere_count) : 0; }
+
+    // Method to check for ray-object intersection by walking the stored BVH.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        double best_t = infinity;
+        int best_index = -1;
+        sphere_soa_query q = make_query(r);
+        bool hit_anything = bvh_traverse(nodes, node_count, r, ray_t, [&](int first, int count, interval& t) {
+            sphere_soa_query leaf = q;
+            leaf.count = first + count; // The scalar kernel scans [first, count).
+            leaf.t_min = t.min;
+            leaf.t_max = t.max;
+            int before = best_index;
+            sphere_soa_hit_scalar(leaf, first, best_t, best_index);
+            if (best_index == before) {
+                return false;
+            }
+            t.max = best_t; // Only closer hits count from now on.
+            return true;
+        });
+        if (!hit_anything) {
+            return false;
+        }
+        record_hit(r, best_index, best_t, rec);
+        return true;
+    }
+
+    // Method to trace a packet of rays together, sharing node tests across the packet.
+    void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        bvh_packet p(rays, count, ray_t.max);
+        int best_index[max_packet_size];
+        for (int k = 0; k < count; k++) {
+            best_index[k] = -1;
+        }
+        bvh_traverse_packet(nodes, node_count, p, ray_t.min, kernel, [&](int first, int n, int k) {
+            sphere_soa_query leaf = make_query(rays[k]);
+            leaf.count = first + n; // The scalar kernel scans [first, count).
+            leaf.t_min = ray_t.min;
+            leaf.t_max = p.t_max[k];
+            double best_t = infinity;
+            int before = best_index[k];
+            sphere_soa_hit_scalar(leaf, first, best_t, best_index[k]);
+            if (best_index[k] != before) {
+                p.t_max[k] = best_t; // Only closer hits count from now on.
+            }
+        });
+        for (int k = 0; k < count; k++) {
+            hits[k] = best_index[k] >= 0;
+            if (hits[k]) {
+                record_hit(rays[k], best_index[k], p.t_max[k], recs[k]);
+            }
+        }
+    }
+
+    // Method to check whether the ray hits any sphere, stopping at the first one found.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        sphere_soa_query q = make_query(r);
+        return bvh_traverse<true>(nodes, node_count, r, ray_t, [&](int first, int count, interval& t) {
+            sphere_soa_query leaf = q;
+            leaf.count = first + count;
+            leaf.t_min = t.min;
+            leaf.t_max = t.max;
+            double best_t = infinity;
+            int best_index = -1;
+            sphere_soa_hit_scalar(leaf, first, best_t, best_index);
+            return best_index >= 0;
+        });
+    }
+
+    // Method returning the bounding box of the whole scene (the BVH root).
+    aabb bounding_box() const override {
+        if (node_count == 0) {
+            return aabb();
+        }
+        return aabb(point3(nodes[0].bounds_min[0], nodes[0].bounds_min[1], nodes[0].bounds_min[2]),
+                    point3(nodes[0].bounds_max[0], nodes[0].bounds_max[1], nodes[0].bounds_max[2]));
+    }
+
+private:
+    void* mapped = nullptr; // Memory mapping, if the scene came from a file.
+    size_t mapped_size = 0; // Size of the mapping.
+    struct alignas(64) block { unsigned char bytes[64]; };
+    std::vector<block> owned; // Aligned buffer, if the scene came from memory.
+
+    const scene_file_header* header = nullptr; // Header inside the mapping or buffer.
+    const double* spheres = nullptr; // x, y, z and radius arrays, one after the other.
+    const bvh_node* nodes = nullptr; // Flattened BVH.
+    int node_count = 0;
+    simd_level kernel = detect_simd_level(); // Packet node kernel.
+
+    // Point the accessors into a compiled scene image after checking its header.
+    bool attach(const unsigned char* bytes, size_t size, std::string& error) {
+        const auto* h = reinterpret_cast<const scene_file_header*>(bytes);
+        if (size < sizeof(scene_file_header) || std::memcmp(h->magic, scene_file_magic, sizeof(h->magic)) != 0) {
+            error = "not a compiled scene file";
+            return false;
+        }
+        if (h->version != scene_file_version || h->endian_check != 0x01020304) {
+            error = "unsupported scene file version or byte order";
+            return false;
+        }
+        uint64_t n = h->sphere_count;
+        // Sizes are compared by division, so offsets and counts near 2^64 cannot wrap around.
+        bool layout_ok = h->file_size == size
+            && h->spheres_offset % 64 == 0 && h->nodes_offset % 64 == 0
+            && h->spheres_offset <= h->nodes_offset && h->nodes_offset <= size
+            && n <= (h->nodes_offset - h->spheres_offset) / (4 * sizeof(double))
+            && h->node_count <= (size - h->nodes_offset) / sizeof(bvh_node)
+            && n < (uint64_t(1) << 31) && h->node_count < (uint64_t(1) << 31);
+        bool camera_ok = h->aspect_ratio > 0 && h->image_width > 0 && h->samples_per_pixel > 0 && h->max_depth >= 0 &&
+                         h->vfov > 0 && h->vfov < 180; // As parse_scene_text accepts.
+        if (camera_ok) {
+            header = h; // Borrowed for apply(), which the view check needs.
+            camera view;
+            apply(view);
+            std::string view_error;
+            camera_ok = check_camera_view(view, view_error);
+            header = nullptr;
+        }
+        if (!layout_ok || !camera_ok || !nodes_valid(reinterpret_cast<const bvh_node*>(bytes + h->nodes_offset), int(h->node_count), int(n))) {
+            error = "corrupt scene file";
+            return false;
+        }
+
+        header = h;
+        spheres = reinterpret_cast<const double*>(bytes + h->spheres_offset);
+        nodes = reinterpret_cast<const bvh_node*>(bytes + h->nodes_offset);
+        node_count = int(h->node_count);
+        return true;
+    }
+
+    // Check that nodes form one depth-first tree that traversal can walk safely: every node is
+    // reached exactly once in array order, leaves stay inside the sphere arrays, interior nodes
+    // have a valid split axis, and no node is deeper than the traversal stack allows.
+    static bool nodes_valid(const bvh_node* nodes, int node_count, int sphere_count) {
+        if (node_count == 0) {
+            return sphere_count == 0;
+        }
+        struct pending { int node, depth; };
+        std::vector<pending> stack; // Second children still to check.
+        int next = 0; // Index the depth-first walk must reach next.
+        int depth = 0;
+        while (true) {
+            const bvh_node& node = nodes[next];
+            if (depth >= bvh_max_depth) {
+                return false;
+            }
+            if (node.count > 0) {
+                if (node.offset < 0 || node.offset > sphere_count - node.count) {
+                    return false; // Leaf range outside the spheres.
+                }
+            }
+            else {
+                if (node.count < 0 || node.axis < 0 || node.axis > 2 || node.offset <= next + 1 || node.offset >= node_count) {
+                    return false;
+                }
+                stack.push_back({node.offset, depth + 1});
+            }
+            next++;
+            if (node.count == 0) {
+                depth++; // The first child follows its parent.
+            }
+            else if (stack.empty()) {
+                return next == node_count; // Every node belongs to the tree.
+            }
+            else {
+                if (stack.back().node != next) {
+                    return false; // A second child must start right after the first subtree.
+                }
+                depth = stack.back().depth;
+                stack.pop_back();
+            }
+            if (next >= node_count) {
+                return false;
+            }
+        }
+    }
+
+    // Fill in a hit with sphere index at distance t exactly as sphere::hit does.
+    void record_hit(const ray& r, int index, double t, hit_record& rec) const {
+        size_t n = sphere_count();
+        point3 center(spheres[index], spheres[n + index], spheres[2 * n + index]);
+        rec.t = t; // Update intersection parameter t.
+        rec.p = r.at(rec.t); // Compute intersection point.
+        vec3 outward_normal = (rec.p - center) / spheres[3 * n + index]; // Compute outward normal vector.
+        rec.set_face_normal(r, outward_normal); // Set face normal of hit record.
+    }
+
+    // Query data for a ray against the stored sphere arrays.
+    sphere_soa_query make_query(const ray& r) const {
+        size_t n = sphere_count();
+        sphere_soa_query q;
+        q.cx = spheres;
+        q.cy = spheres + n;
+        q.cz = spheres + 2 * n;
+        q.radius = spheres + 3 * n;
+        q.count = 0;
+        for (int k = 0; k < 3; k++) {
+            q.o[k] = r.origin()[k];
+            q.d[k] = r.direction()[k];
+        }
+        q.a = r.direction().length_squared(); // Squared length of ray direction.
+        q.t_min = 0;
+        q.t_max = infinity;
+        return q;
+    }
+};
+
+// Check whether a file is a compiled scene (by its magic).
+inline bool is_compiled_scene_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(scene_file_magic)] = {};
+    in.read(magic, sizeof(magic));
+    return in.gcount() == sizeof(magic) && std::memcmp(magic, scene_file_magic, sizeof(magic)) == 0;
+}
+
+// Load any scene file: compiled scenes are mapped, text scenes are parsed and compiled in memory.
+inline bool load_scene(const std::string& path, mapped_scene& scene, std::string& error) {
+    if (is_compiled_scene_file(path)) {
+        return scene.open(path, error); // Compiled scene: map it.
+    }
+    scene_description description;
+    if (!read_scene_text(path, description, error)) {
+        return false;
+    }
+    return scene.open(compile_scene(description), error);
+}
+
+// Compile a text scene file into a binary scene file. Returns false and sets error on failure.
+inline bool compile_scene_file(const std::string& text_path, const std::string& binary_path, std::string& error) {
+    scene_description description;
+    if (!read_scene_text(text_path, description, error)) {
+        return false;
+    }
+
+    std::vector<unsigned char> bytes = compile_scene(description);
+    std::ofstream out(binary_path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
+    if (!out) {
+        error = "cannot write " + binary_path;
+        return false;
+    }
+    return true;
+}
+
+#endif // SCENE_FILE_H
@@ -0,0 +1,61 @@
+/***************************************************************
+* Description: Header file for SIMD support: the instruction  *
+*              sets the vectorized kernels can use and runtime *
+*              detection of the best one the CPU supports.     *
+***************************************************************/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RT_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Placed before a loop whose iterations are independent and whose pointers do not overlap, so the
+// compiler vectorizes it without run-time alias checks (which it gives up on past a few pointers).
+#if defined(__clang__)
+#define RT_INDEPENDENT_LOOP _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define RT_INDEPENDENT_LOOP _Pragma("GCC ivdep")
+#else
+#define RT_INDEPENDENT_LOOP
+#endif
+
+// Instruction sets the SIMD kernels can run on.
+enum class simd_level {
+    scalar, // Plain C++, one element at a time.
+    sse2, // 2 doubles per step.
+    avx2, // 4 doubles per step.
+    avx512, // 8 doubles per step.
+    automatic // Best level the CPU supports.
+};
+
+// Best instruction set supported by the running CPU, detected once.
+inline simd_level detect_simd_level() {
+#ifdef RT_SIMD_X86
+    static const simd_level level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return simd_level::avx512;
+        if (__builtin_cpu_supports("avx2")) return simd_level::avx2;
+        if (__builtin_cpu_supports("sse2")) return simd_level::sse2;
+        return simd_level::scalar;
+    }();
+    return level;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+// Human-readable name of an instruction set.
+inline const char* simd_level_name(simd_level level) {
+    switch (level) {
+        case simd_level::sse2: return "sse2";
+        case simd_level::avx2: return "avx2";
+        case simd_level::avx512: return "avx512";
+        case simd_level::automatic: return "automatic";
+        default: return "scalar";
+    }
+}
+
+#endif // SIMD_H
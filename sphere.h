@@ -9,15 +9,46 @@
 
 #include "hittable.h" // Include necessary header files.
 #include "vec3.h"
+#include "stats.h"
 
 // Class representing a sphere object.
 class sphere : public hittable {
 public:
     // Constructors:
-    sphere(const point3& center, double radius) : center(center), radius(fmax(0, radius)) {}
+    sphere(const point3& center, real radius) : center(center), radius(std::fmax(real(0), radius)) {
+        auto rvec = vec3(this->radius, this->radius, this->radius);
+        bbox = aabb(center - rvec, center + rvec); // Box spanning the sphere's extent on every axis.
+    }
 
     // Method to check for ray-sphere intersection.
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        real root;
+        if (!nearest_root(r, ray_t, root)) {
+            return false; // No intersection within the interval.
+        }
+
+        // Record intersection details.
+        rec.t = root; // Update intersection parameter t.
+        rec.p = r.at(rec.t); // Compute intersection point.
+        vec3 outward_normal = (rec.p - center) / radius; // Compute outward normal vector.
+        rec.set_face_normal(r, outward_normal); // Set face normal of hit record.
+
+        return true; // Intersection found.
+    }
+
+    // Method to check whether the ray hits the sphere, without filling in a hit record.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        real root;
+        return nearest_root(r, ray_t, root);
+    }
+
+    // Method returning the bounding box of the sphere.
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    // Find the nearest ray parameter within ray_t at which the ray meets the sphere.
+    bool nearest_root(const ray& r, const interval& ray_t, real& root) const {
         vec3 oc = center - r.origin(); // Vector from ray origin to sphere center.
         auto a = r.direction().length_squared(); // Squared length of ray direction.
         auto h = dot(r.direction(), oc); // Projection of oc onto ray direction.
@@ -28,9 +59,9 @@ public:
             return false; // No intersection if discriminant is negative.
         }
 
-        auto sqrtd = sqrt(discriminant); // Square root of discriminant.
+        auto sqrtd = std::sqrt(discriminant); // Square root of discriminant.
 
-        auto root = (h - sqrtd) / a; // First root of quadratic equation.
+        root = (h - sqrtd) / a; // First root of quadratic equation.
 
         // Check if the first root is within the specified ray interval.
         if (!ray_t.surrounds(root)) {
@@ -40,19 +71,12 @@ public:
                 return false; // No intersection if both roots are outside the interval.
             }
         }
-
-        // Record intersection details.
-        rec.t = root; // Update intersection parameter t.
-        rec.p = r.at(rec.t); // Compute intersection point.
-        vec3 outward_normal = (rec.p - center) / radius; // Compute outward normal vector.
-        rec.set_face_normal(r, outward_normal); // Set face normal of hit record.
-
-        return true; // Intersection found.
+        return true;
     }
 
-private:
     point3 center; // Center of the sphere.
-    double radius; // Radius of the sphere.
+    real radius; // Radius of the sphere.
+    aabb bbox; // Bounding box of the sphere.
 };
 
 #endif // SPHERE_H
\ No newline at end of file
@@ -0,0 +1,300 @@
+/***************************************************************
+* Description: Header file for the sphere_set class, a packed  *
+*              collection of spheres stored as arrays that is  *
+*              intersected several spheres at a time with SIMD.*
+***************************************************************/
+
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "stats.h"
+#include "simd.h"
+
+#include <vector> // Include necessary standard library headers.
+
+// Sphere arrays plus the ray data every kernel needs. The arithmetic in all kernels follows
+// sphere::hit operation for operation (no fused multiply-adds), so every level finds exactly the
+// same hit as a hittable_list of spheres.
+struct sphere_soa_query {
+    const double* cx; // Sphere centers, one array per axis.
+    const double* cy;
+    const double* cz;
+    const double* radius; // Sphere radii.
+    int count; // Number of spheres.
+    double o[3]; // Ray origin.
+    double d[3]; // Ray direction.
+    double a; // Squared length of the ray direction.
+    double t_min, t_max; // Open interval of accepted hit distances.
+};
+
+// Scalar kernel for spheres [begin, count). Keeps the closest hit in best_t / best_index; on ties
+// the lower index wins, like the sequential scan in hittable_list.
+inline void sphere_soa_hit_scalar(const sphere_soa_query& q, int begin, double& best_t, int& best_index) {
+    for (int i = begin; i < q.count; i++) {
+        double ocx = q.cx[i] - q.o[0]; // Vector from ray origin to sphere center.
+        double ocy = q.cy[i] - q.o[1];
+        double ocz = q.cz[i] - q.o[2];
+        double h = q.d[0] * ocx + q.d[1] * ocy + q.d[2] * ocz; // Projection of oc onto ray direction.
+        double c = (ocx * ocx + ocy * ocy + ocz * ocz) - q.radius[i] * q.radius[i];
+        double discriminant = h * h - q.a * c;
+        if (discriminant < 0) {
+            continue;
+        }
+        double sqrtd = sqrt(discriminant);
+        double root = (h - sqrtd) / q.a;
+        if (!(q.t_min < root && root < q.t_max)) {
+            root = (h + sqrtd) / q.a;
+            if (!(q.t_min < root && root < q.t_max)) {
+                continue;
+            }
+        }
+        if (root < best_t) {
+            best_t = root;
+            best_index = i;
+        }
+    }
+}
+
+#ifdef RT_SIMD_X86
+
+// Fold per-lane results into best_t / best_index, preferring the lower index on ties.
+inline void sphere_soa_reduce(const double* lane_t, const double* lane_index, int lanes, double& best_t, int& best_index) {
+    for (int l = 0; l < lanes; l++) {
+        int index = int(lane_index[l]);
+        if (index < 0) {
+            continue;
+        }
+        if (lane_t[l] < best_t || (lane_t[l] == best_t && index < best_index)) {
+            best_t = lane_t[l];
+            best_index = index;
+        }
+    }
+}
+
+// SSE2 kernel: 2 spheres per step.
+__attribute__((target("sse2"))) inline void sphere_soa_hit_sse2(const sphere_soa_query& q, double& best_t, int& best_index) {
+    const __m128d ox = _mm_set1_pd(q.o[0]), oy = _mm_set1_pd(q.o[1]), oz = _mm_set1_pd(q.o[2]);
+    const __m128d dx = _mm_set1_pd(q.d[0]), dy = _mm_set1_pd(q.d[1]), dz = _mm_set1_pd(q.d[2]);
+    const __m128d a = _mm_set1_pd(q.a), t_min = _mm_set1_pd(q.t_min), t_max = _mm_set1_pd(q.t_max);
+    const __m128d inf = _mm_set1_pd(infinity), step = _mm_set1_pd(2);
+    __m128d lane_t = inf, lane_index = _mm_set1_pd(-1), index = _mm_set_pd(1, 0);
+
+    int i = 0;
+    for (; i + 2 <= q.count; i += 2) {
+        __m128d ocx = _mm_sub_pd(_mm_loadu_pd(q.cx + i), ox);
+        __m128d ocy = _mm_sub_pd(_mm_loadu_pd(q.cy + i), oy);
+        __m128d ocz = _mm_sub_pd(_mm_loadu_pd(q.cz + i), oz);
+        __m128d r = _mm_loadu_pd(q.radius + i);
+        __m128d h = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, ocx), _mm_mul_pd(dy, ocy)), _mm_mul_pd(dz, ocz));
+        __m128d len2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)), _mm_mul_pd(ocz, ocz));
+        __m128d c = _mm_sub_pd(len2, _mm_mul_pd(r, r));
+        __m128d disc = _mm_sub_pd(_mm_mul_pd(h, h), _mm_mul_pd(a, c));
+        if (_mm_movemask_pd(_mm_cmpge_pd(disc, _mm_setzero_pd())) == 0) {
+            index = _mm_add_pd(index, step);
+            continue; // Every sphere in this step is missed: skip the square root and divisions.
+        }
+        __m128d sqrtd = _mm_sqrt_pd(disc); // NaN for misses; NaN fails every comparison below.
+        __m128d root1 = _mm_div_pd(_mm_sub_pd(h, sqrtd), a);
+        __m128d root2 = _mm_div_pd(_mm_add_pd(h, sqrtd), a);
+        __m128d in1 = _mm_and_pd(_mm_cmpgt_pd(root1, t_min), _mm_cmplt_pd(root1, t_max));
+        __m128d in2 = _mm_and_pd(_mm_cmpgt_pd(root2, t_min), _mm_cmplt_pd(root2, t_max));
+        __m128d t = _mm_or_pd(_mm_and_pd(in2, root2), _mm_andnot_pd(in2, inf));
+        t = _mm_or_pd(_mm_and_pd(in1, root1), _mm_andnot_pd(in1, t));
+        __m128d closer = _mm_cmplt_pd(t, lane_t);
+        lane_t = _mm_or_pd(_mm_and_pd(closer, t), _mm_andnot_pd(closer, lane_t));
+        lane_index = _mm_or_pd(_mm_and_pd(closer, index), _mm_andnot_pd(closer, lane_index));
+        index = _mm_add_pd(index, step);
+    }
+
+    alignas(16) double lt[2], li[2];
+    _mm_store_pd(lt, lane_t);
+    _mm_store_pd(li, lane_index);
+    sphere_soa_reduce(lt, li, 2, best_t, best_index);
+    sphere_soa_hit_scalar(q, i, best_t, best_index); // Leftover spheres.
+}
+
+// AVX2 kernel: 4 spheres per step. FMA is deliberately not enabled, so results match sphere::hit.
+__attribute__((target("avx2"))) inline void sphere_soa_hit_avx2(const sphere_soa_query& q, double& best_t, int& best_index) {
+    const __m256d ox = _mm256_set1_pd(q.o[0]), oy = _mm256_set1_pd(q.o[1]), oz = _mm256_set1_pd(q.o[2]);
+    const __m256d dx = _mm256_set1_pd(q.d[0]), dy = _mm256_set1_pd(q.d[1]), dz = _mm256_set1_pd(q.d[2]);
+    const __m256d a = _mm256_set1_pd(q.a), t_min = _mm256_set1_pd(q.t_min), t_max = _mm256_set1_pd(q.t_max);
+    const __m256d inf = _mm256_set1_pd(infinity), step = _mm256_set1_pd(4);
+    __m256d lane_t = inf, lane_index = _mm256_set1_pd(-1), index = _mm256_set_pd(3, 2, 1, 0);
+
+    int i = 0;
+    for (; i + 4 <= q.count; i += 4) {
+        __m256d ocx = _mm256_sub_pd(_mm256_loadu_pd(q.cx + i), ox);
+        __m256d ocy = _mm256_sub_pd(_mm256_loadu_pd(q.cy + i), oy);
+        __m256d ocz = _mm256_sub_pd(_mm256_loadu_pd(q.cz + i), oz);
+        __m256d r = _mm256_loadu_pd(q.radius + i);
+        __m256d h = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, ocx), _mm256_mul_pd(dy, ocy)), _mm256_mul_pd(dz, ocz));
+        __m256d len2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz));
+        __m256d c = _mm256_sub_pd(len2, _mm256_mul_pd(r, r));
+        __m256d disc = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(a, c));
+        if (_mm256_movemask_pd(_mm256_cmp_pd(disc, _mm256_setzero_pd(), _CMP_GE_OQ)) == 0) {
+            index = _mm256_add_pd(index, step);
+            continue; // Every sphere in this step is missed: skip the square root and divisions.
+        }
+        __m256d sqrtd = _mm256_sqrt_pd(disc); // NaN for misses; NaN fails every comparison below.
+        __m256d root1 = _mm256_div_pd(_mm256_sub_pd(h, sqrtd), a);
+        __m256d root2 = _mm256_div_pd(_mm256_add_pd(h, sqrtd), a);
+        __m256d in1 = _mm256_and_pd(_mm256_cmp_pd(root1, t_min, _CMP_GT_OQ), _mm256_cmp_pd(root1, t_max, _CMP_LT_OQ));
+        __m256d in2 = _mm256_and_pd(_mm256_cmp_pd(root2, t_min, _CMP_GT_OQ), _mm256_cmp_pd(root2, t_max, _CMP_LT_OQ));
+        __m256d t = _mm256_blendv_pd(_mm256_blendv_pd(inf, root2, in2), root1, in1);
+        __m256d closer = _mm256_cmp_pd(t, lane_t, _CMP_LT_OQ);
+        lane_t = _mm256_blendv_pd(lane_t, t, closer);
+        lane_index = _mm256_blendv_pd(lane_index, index, closer);
+        index = _mm256_add_pd(index, step);
+    }
+
+    alignas(32) double lt[4], li[4];
+    _mm256_store_pd(lt, lane_t);
+    _mm256_store_pd(li, lane_index);
+    sphere_soa_reduce(lt, li, 4, best_t, best_index);
+    sphere_soa_hit_scalar(q, i, best_t, best_index); // Leftover spheres.
+}
+
+// AVX-512 kernel: 8 spheres per step. Contraction into FMAs is switched off to match sphere::hit.
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+inline void sphere_soa_hit_avx512(const sphere_soa_query& q, double& best_t, int& best_index) {
+    const __m512d ox = _mm512_set1_pd(q.o[0]), oy = _mm512_set1_pd(q.o[1]), oz = _mm512_set1_pd(q.o[2]);
+    const __m512d dx = _mm512_set1_pd(q.d[0]), dy = _mm512_set1_pd(q.d[1]), dz = _mm512_set1_pd(q.d[2]);
+    const __m512d a = _mm512_set1_pd(q.a), t_min = _mm512_set1_pd(q.t_min), t_max = _mm512_set1_pd(q.t_max);
+    const __m512d inf = _mm512_set1_pd(infinity), step = _mm512_set1_pd(8);
+    __m512d lane_t = inf, lane_index = _mm512_set1_pd(-1), index = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+
+    int i = 0;
+    for (; i + 8 <= q.count; i += 8) {
+        __m512d ocx = _mm512_sub_pd(_mm512_loadu_pd(q.cx + i), ox);
+        __m512d ocy = _mm512_sub_pd(_mm512_loadu_pd(q.cy + i), oy);
+        __m512d ocz = _mm512_sub_pd(_mm512_loadu_pd(q.cz + i), oz);
+        __m512d r = _mm512_loadu_pd(q.radius + i);
+        __m512d h = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, ocx), _mm512_mul_pd(dy, ocy)), _mm512_mul_pd(dz, ocz));
+        __m512d len2 = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(ocx, ocx), _mm512_mul_pd(ocy, ocy)), _mm512_mul_pd(ocz, ocz));
+        __m512d c = _mm512_sub_pd(len2, _mm512_mul_pd(r, r));
+        __m512d disc = _mm512_sub_pd(_mm512_mul_pd(h, h), _mm512_mul_pd(a, c));
+        if (_mm512_cmp_pd_mask(disc, _mm512_setzero_pd(), _CMP_GE_OQ) == 0) {
+            index = _mm512_add_pd(index, step);
+            continue; // Every sphere in this step is missed: skip the square root and divisions.
+        }
+        __m512d sqrtd = _mm512_sqrt_pd(disc); // NaN for misses; NaN fails every comparison below.
+        __m512d root1 = _mm512_div_pd(_mm512_sub_pd(h, sqrtd), a);
+        __m512d root2 = _mm512_div_pd(_mm512_add_pd(h, sqrtd), a);
+        __mmask8 in1 = _mm512_cmp_pd_mask(root1, t_min, _CMP_GT_OQ) & _mm512_cmp_pd_mask(root1, t_max, _CMP_LT_OQ);
+        __mmask8 in2 = _mm512_cmp_pd_mask(root2, t_min, _CMP_GT_OQ) & _mm512_cmp_pd_mask(root2, t_max, _CMP_LT_OQ);
+        __m512d t = _mm512_mask_blend_pd(in1, _mm512_mask_blend_pd(in2, inf, root2), root1);
+        __mmask8 closer = _mm512_cmp_pd_mask(t, lane_t, _CMP_LT_OQ);
+        lane_t = _mm512_mask_blend_pd(closer, lane_t, t);
+        lane_index = _mm512_mask_blend_pd(closer, lane_index, index);
+        index = _mm512_add_pd(index, step);
+    }
+
+    alignas(64) double lt[8], li[8];
+    _mm512_store_pd(lt, lane_t);
+    _mm512_store_pd(li, lane_index);
+    sphere_soa_reduce(lt, li, 8, best_t, best_index);
+    sphere_soa_hit_scalar(q, i, best_t, best_index); // Leftover spheres.
+}
+
+#endif // RT_SIMD_X86
+
+// Class representing many spheres stored as structure-of-arrays, intersected with the widest
+// SIMD kernel the CPU supports.
+class sphere_set : public hittable {
+public:
+    // Constructors:
+    sphere_set() {}
+    explicit sphere_set(simd_level level) { set_simd_level(level); }
+
+    // Add a sphere to the set.
+    void add(const point3& center, double radius) {
+        radius = fmax(0, radius); // Same clamping as sphere.
+        cx.push_back(center.x());
+        cy.push_back(center.y());
+        cz.push_back(center.z());
+        radii.push_back(radius);
+
+        auto rvec = vec3(radius, radius, radius);
+        bbox = aabb(bbox, aabb(center - rvec, center + rvec)); // Grow the bounding box.
+    }
+
+    // Number of spheres in the set.
+    int size() const { return int(radii.size()); }
+
+    // Choose the kernel; automatic (the default) picks the best one the CPU supports.
+    void set_simd_level(simd_level level) {
+        kernel = (level == simd_level::automatic) ? detect_simd_level() : level;
+#ifndef RT_SIMD_X86
+        kernel = simd_level::scalar;
+#endif
+    }
+
+    simd_level get_simd_level() const { return kernel; }
+
+    // Method to check for ray-sphere intersection against every sphere in the set.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        double best_t;
+        int best_index = closest(r, ray_t, best_t);
+        if (best_index < 0) {
+            return false; // No sphere hit within the interval.
+        }
+
+        // Record intersection details exactly as sphere::hit does.
+        point3 center(cx[best_index], cy[best_index], cz[best_index]);
+        rec.t = best_t; // Update intersection parameter t.
+        rec.p = r.at(rec.t); // Compute intersection point.
+        vec3 outward_normal = (rec.p - center) / radii[best_index]; // Compute outward normal vector.
+        rec.set_face_normal(r, outward_normal); // Set face normal of hit record.
+        return true;
+    }
+
+    // Method to check whether the ray hits any sphere in the set.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        double best_t;
+        return closest(r, ray_t, best_t) >= 0; // The SIMD sweep is cheap enough to run in full.
+    }
+
+    // Method returning the bounding box of all spheres in the set.
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    std::vector<double> cx, cy, cz; // Sphere centers, one array per axis.
+    std::vector<double> radii; // Sphere radii.
+    aabb bbox; // Bounding box enclosing every sphere.
+    simd_level kernel = detect_simd_level(); // Kernel used by hit().
+
+    // Run the selected kernel; returns the index of the closest sphere hit (or -1) and its distance.
+    int closest(const ray& r, const interval& ray_t, double& best_t) const {
+        sphere_soa_query q;
+        q.cx = cx.data();
+        q.cy = cy.data();
+        q.cz = cz.data();
+        q.radius = radii.data();
+        q.count = size();
+        for (int k = 0; k < 3; k++) {
+            q.o[k] = r.origin()[k];
+            q.d[k] = r.direction()[k];
+        }
+        q.a = r.direction().length_squared(); // Squared length of ray direction.
+        q.t_min = ray_t.min;
+        q.t_max = ray_t.max;
+
+        best_t = infinity;
+        int best_index = -1;
+        RT_STAT_ADD(primitive_tests, q.count);
+        switch (kernel) {
+#ifdef RT_SIMD_X86
+            case simd_level::avx512: sphere_soa_hit_avx512(q, best_t, best_index); break;
+            case simd_level::avx2: sphere_soa_hit_avx2(q, best_t, best_index); break;
+            case simd_level::sse2: sphere_soa_hit_sse2(q, best_t, best_index); break;
+#endif
+            default: sphere_soa_hit_scalar(q, 0, best_t, best_index); break;
+        }
+        return best_index;
+    }
+};
+
+#endif // SPHERE_SET_H
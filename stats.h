@@ -0,0 +1,141 @@
+/***************************************************************
+* Description: Header file for render statistics: per-thread  *
+*              hot-path counters that are compiled in only     *
+*              with RT_ENABLE_STATS and merged after a render. *
+***************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint> // Include necessary standard library headers.
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Whether the hot-path counters are compiled in.
+#ifdef RT_ENABLE_STATS
+constexpr bool stats_enabled = true;
+#else
+constexpr bool stats_enabled = false;
+#endif
+
+constexpr int path_length_bins = 64; // Histogram bins; the last one also holds longer paths.
+
+// Counters gathered while tracing. Every thread counts into its own copy.
+struct render_counters {
+    uint64_t primary_rays = 0; // Rays leaving the camera.
+    uint64_t bounce_rays = 0; // Rays continuing a path after a hit.
+    uint64_t hit_calls = 0; // Calls to hittable::hit on any object, nested calls included.
+    uint64_t node_tests = 0; // Ray-box tests against acceleration structure nodes.
+    uint64_t primitive_tests = 0; // Ray-primitive intersection tests.
+    uint64_t path_lengths[path_length_bins] = {}; // Camera paths by number of rays traced.
+
+    // Add another set of counters to this one.
+    void merge(const render_counters& other) {
+        primary_rays += other.primary_rays;
+        bounce_rays += other.bounce_rays;
+        hit_calls += other.hit_calls;
+        node_tests += other.node_tests;
+        primitive_tests += other.primitive_tests;
+        for (int i = 0; i < path_length_bins; i++) {
+            path_lengths[i] += other.path_lengths[i];
+        }
+    }
+};
+
+// Class collecting the counters of every thread. Threads hand their counts over when they exit
+// (or when the calling thread collects), so counting itself never touches shared memory.
+class stats_registry {
+public:
+    static stats_registry& instance() {
+        static stats_registry registry;
+        return registry;
+    }
+
+    void add(const render_counters& counters) {
+        std::lock_guard<std::mutex> lock(mutex);
+        total.merge(counters);
+    }
+
+    render_counters get() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        total = render_counters();
+    }
+
+private:
+    std::mutex mutex; // Guards total.
+    render_counters total; // Counts handed over so far.
+};
+
+// The calling thread's counters; they are handed to the registry when the thread exits.
+inline render_counters& thread_counters() {
+    struct holder {
+        render_counters counters;
+        ~holder() { stats_registry::instance().add(counters); }
+    };
+    thread_local holder h;
+    return h.counters;
+}
+
+// Merged counters of all finished threads plus the calling thread. Render threads finish when the
+// camera's pool shuts down at the end of a render.
+inline render_counters collect_stats() {
+    render_counters& mine = thread_counters();
+    stats_registry::instance().add(mine);
+    mine = render_counters();
+    return stats_registry::instance().get();
+}
+
+// Forget all counts gathered so far.
+inline void reset_stats() {
+    thread_counters() = render_counters();
+    stats_registry::instance().reset();
+}
+
+// Count an event on the hot path. Compiles to nothing unless RT_ENABLE_STATS is defined.
+#ifdef RT_ENABLE_STATS
+#define RT_STAT_ADD(counter, n) (thread_counters().counter += uint64_t(n))
+#else
+#define RT_STAT_ADD(counter, n) ((void)0)
+#endif
+
+// Count one camera path of the given length (in rays).
+#define RT_STAT_PATH(length) RT_STAT_ADD(path_lengths[(length) < path_length_bins ? (length) : path_length_bins - 1], 1)
+
+// Write the counters of a render, its time and its per-tile times (tile by tile, row by row) as a
+// JSON object.
+inline void write_stats_json(std::ostream& out, const render_counters& c, double seconds,
+                             int tile_size, int tiles_x, const std::vector<double>& tile_seconds) {
+    double rays = double(c.primary_rays + c.bounce_rays);
+    out << "{\n  \"counters_enabled\": " << (stats_enabled ? "true" : "false")
+        << ",\n  \"seconds\": " << seconds
+        << ",\n  \"primary_rays\": " << c.primary_rays
+        << ",\n  \"bounce_rays\": " << c.bounce_rays
+        << ",\n  \"rays_per_second\": " << (seconds > 0 ? rays / seconds : 0)
+        << ",\n  \"hit_calls\": " << c.hit_calls
+        << ",\n  \"node_tests\": " << c.node_tests
+        << ",\n  \"primitive_tests\": " << c.primitive_tests;
+
+    // Histogram without the empty tail.
+    int bins = path_length_bins;
+    while (bins > 0 && c.path_lengths[bins - 1] == 0) {
+        bins--;
+    }
+    out << ",\n  \"path_length_histogram\": [";
+    for (int i = 0; i < bins; i++) {
+        out << (i ? ", " : "") << c.path_lengths[i];
+    }
+
+    out << "],\n  \"tile_size\": " << tile_size << ",\n  \"tiles_x\": " << tiles_x << ",\n  \"tile_seconds\": [";
+    for (size_t i = 0; i < tile_seconds.size(); i++) {
+        out << (i ? ", " : "") << tile_seconds[i];
+    }
+    out << "]\n}\n";
+}
+
+#endif // STATS_H
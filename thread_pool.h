@@ -0,0 +1,231 @@
+/***************************************************************
+* Description: Header file for the thread_pool and task_group  *
+*              classes, a small work-stealing scheduler used   *
+*              to spread rendering work across CPU cores.      *
+***************************************************************/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic> // Include necessary standard library headers.
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Class representing a fixed set of worker threads. Every worker owns a task queue; it pops work
+// from the back of its own queue and steals from the front of the other queues once it runs dry.
+class thread_pool {
+public:
+    // Constructors:
+    // thread_count counts the calling thread too, since it helps out while waiting (0 = all cores).
+    explicit thread_pool(int thread_count = 0) {
+        if (thread_count <= 0) {
+            thread_count = int(std::thread::hardware_concurrency()); // Use every hardware thread.
+        }
+        thread_count = (thread_count < 1) ? 1 : thread_count; // Always keep at least the caller.
+
+        for (int i = 0; i < thread_count; i++) {
+            queues.push_back(std::make_unique<task_queue>()); // One queue per thread.
+        }
+        for (int i = 1; i < thread_count; i++) {
+            workers.emplace_back([this, i] { worker_loop(i); }); // Slot 0 belongs to outside threads.
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true; // Ask the workers to finish.
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Number of threads that execute tasks, including the waiting caller.
+    int size() const { return int(queues.size()); }
+
+    // Queue a task. Workers push onto their own queue; outside threads deal tasks round-robin.
+    void submit(std::function<void()> task) {
+        int slot = current_slot();
+        if (slot < 0) {
+            slot = int(next_slot.fetch_add(1, std::memory_order_relaxed) % queues.size());
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[slot]->mutex);
+            queues[slot]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex); // Pairs with the sleep check in worker_loop.
+        }
+        wake.notify_one();
+    }
+
+    // Run one queued task on the calling thread, if there is any. Returns whether a task ran.
+    bool run_pending_task() {
+        std::function<void()> task;
+        if (!take_task(current_slot(), task)) {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+    // Run body(i) for every i in [begin, end) and wait for all of them to finish.
+    template <typename Body>
+    void parallel_for(int begin, int end, Body&& body);
+
+private:
+    struct task_queue {
+        std::mutex mutex; // Guards the task deque.
+        std::deque<std::function<void()>> tasks; // Pending tasks, newest at the back.
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues; // Per-thread task queues.
+    std::vector<std::thread> workers; // Worker threads (the caller is not stored here).
+    std::atomic<int> queued{0}; // Number of tasks sitting in any queue.
+    std::atomic<unsigned> next_slot{0}; // Round-robin cursor for tasks submitted from outside.
+    std::mutex sleep_mutex; // Guards sleeping and stopping.
+    std::condition_variable wake; // Signalled when work arrives or the pool shuts down.
+    bool stopping = false; // Set once the pool is being destroyed.
+
+    // Identity of the calling thread inside this pool (-1 for outside threads).
+    struct thread_identity {
+        const thread_pool* pool = nullptr;
+        int slot = -1;
+    };
+
+    static thread_identity& identity() {
+        thread_local thread_identity id;
+        return id;
+    }
+
+    int current_slot() const {
+        const auto& id = identity();
+        return (id.pool == this) ? id.slot : -1;
+    }
+
+    // Pop from our own queue first, then try to steal from the others.
+    bool take_task(int slot, std::function<void()>& task) {
+        if (queued.load(std::memory_order_acquire) == 0) {
+            return false; // Nothing queued anywhere.
+        }
+
+        int n = int(queues.size());
+        int home = (slot < 0) ? 0 : slot;
+        for (int k = 0; k < n; k++) {
+            auto& q = *queues[(home + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) {
+                continue;
+            }
+            if (k == 0 && slot >= 0) {
+                task = std::move(q.tasks.back()); // Own queue: newest first, for locality.
+                q.tasks.pop_back();
+            }
+            else {
+                task = std::move(q.tasks.front()); // Steal the oldest (largest remaining) work.
+                q.tasks.pop_front();
+            }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Main loop of a worker thread.
+    void worker_loop(int slot) {
+        identity() = thread_identity{this, slot};
+        std::function<void()> task;
+        while (true) {
+            if (take_task(slot, task)) {
+                task();
+                task = nullptr; // Release captured state before sleeping.
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            if (stopping) {
+                return;
+            }
+            if (queued.load(std::memory_order_acquire) == 0) {
+                wake.wait(lock); // Sleep until new work or shutdown.
+            }
+        }
+    }
+};
+
+// Class tracking a batch of tasks submitted to a thread_pool so they can be waited on together.
+// Waiting threads keep executing queued tasks, so groups may be nested inside pool tasks.
+class task_group {
+public:
+    explicit task_group(thread_pool& pool) : pool(pool) {}
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    ~task_group() { wait_quietly(); }
+
+    // Submit a task as part of this group.
+    template <typename Task>
+    void run(Task&& task) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.submit([this, task = std::forward<Task>(task)]() mutable {
+            try {
+                task();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception(); // Keep the first failure.
+                }
+            }
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+
+    // Wait for every task in the group, helping with queued work meanwhile. Rethrows the first
+    // exception thrown by a task.
+    void wait() {
+        wait_quietly();
+        if (error) {
+            auto e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    thread_pool& pool; // Pool that runs the tasks.
+    std::atomic<int> pending{0}; // Tasks submitted but not yet finished.
+    std::mutex error_mutex; // Guards error.
+    std::exception_ptr error; // First exception thrown by a task.
+
+    void wait_quietly() {
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (!pool.run_pending_task()) {
+                std::this_thread::yield(); // Remaining tasks are running on other threads.
+            }
+        }
+    }
+};
+
+template <typename Body>
+void thread_pool::parallel_for(int begin, int end, Body&& body) {
+    task_group group(*this);
+    for (int i = begin; i < end; i++) {
+        group.run([&body, i] { body(i); });
+    }
+    group.wait();
+}
+
+#endif // THREAD_POOL_H
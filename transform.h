@@ -0,0 +1,124 @@
+/***************************************************************
+* Description: Header file for the transform class, an affine  *
+*              3D transform (3x4 matrix) for placing instances.*
+***************************************************************/
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "aabb.h"
+
+#include <cmath> // Include necessary standard library headers.
+
+// Class representing an affine transform p' = M p + t, stored as a 3x4 matrix in double.
+class transform {
+public:
+    double m[3][4]; // Rows of the linear part, with the translation in the last column.
+
+    // Constructors:
+    transform() : m{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}} {} // Identity.
+
+    // Translation by v.
+    static transform translate(const vec3& v) {
+        transform t;
+        for (int i = 0; i < 3; i++) {
+            t.m[i][3] = v[i];
+        }
+        return t;
+    }
+
+    // Scale by s along each axis.
+    static transform scale(const vec3& s) {
+        transform t;
+        for (int i = 0; i < 3; i++) {
+            t.m[i][i] = s[i];
+        }
+        return t;
+    }
+
+    static transform scale(double s) { return scale(vec3(s, s, s)); }
+
+    // Rotation by an angle in degrees around an axis through the origin (right-handed).
+    static transform rotate(const vec3& axis, double degrees) {
+        vec3 a = unit_vector(axis);
+        double c = std::cos(degrees_to_radians(degrees)), s = std::sin(degrees_to_radians(degrees));
+        double x = a.x(), y = a.y(), z = a.z();
+        transform t;
+        t.m[0][0] = c + x * x * (1 - c);     t.m[0][1] = x * y * (1 - c) - z * s; t.m[0][2] = x * z * (1 - c) + y * s;
+        t.m[1][0] = y * x * (1 - c) + z * s; t.m[1][1] = c + y * y * (1 - c);     t.m[1][2] = y * z * (1 - c) - x * s;
+        t.m[2][0] = z * x * (1 - c) - y * s; t.m[2][1] = z * y * (1 - c) + x * s; t.m[2][2] = c + z * z * (1 - c);
+        return t;
+    }
+
+    // Composition: (a * b) applies b first, then a.
+    friend transform operator*(const transform& a, const transform& b) {
+        transform t;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 4; j++) {
+                t.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + (j == 3 ? a.m[i][3] : 0);
+            }
+        }
+        return t;
+    }
+
+    // Inverse transform. The linear part must be invertible.
+    transform inverse() const {
+        double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                   - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                   + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        double inv_det = 1 / det;
+
+        transform t;
+        t.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det; // Adjugate over determinant.
+        t.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+        t.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        t.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det;
+        t.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        t.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+        t.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        t.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+        t.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+        for (int i = 0; i < 3; i++) {
+            t.m[i][3] = -(t.m[i][0] * m[0][3] + t.m[i][1] * m[1][3] + t.m[i][2] * m[2][3]); // -M^-1 t
+        }
+        return t;
+    }
+
+    // Apply to a point (with translation).
+    point3 point(const point3& p) const {
+        return point3(m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+                      m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+                      m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]);
+    }
+
+    // Apply to a direction (no translation).
+    vec3 vector(const vec3& v) const {
+        return vec3(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+                    m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+                    m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+    }
+
+    // Apply the transpose of the linear part. Called on the inverse transform, this maps normals.
+    vec3 transpose_vector(const vec3& v) const {
+        return vec3(m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2],
+                    m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+                    m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]);
+    }
+
+    // Box enclosing a transformed box (its eight transformed corners).
+    aabb box(const aabb& b) const {
+        if (b.is_empty()) {
+            return b;
+        }
+        aabb result;
+        for (int corner = 0; corner < 8; corner++) {
+            point3 p((corner & 1) ? b.x.max : b.x.min, (corner & 2) ? b.y.max : b.y.min, (corner & 4) ? b.z.max : b.z.min);
+            point3 q = point(p);
+            result = aabb(result, aabb(q, q));
+        }
+        return result;
+    }
+};
+
+#endif // TRANSFORM_H
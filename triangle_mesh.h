@@ -0,0 +1,204 @@
+/***************************************************************
+* Description: Header file for the triangle_mesh class, an     *
+*              indexed triangle mesh with its own BVH and a    *
+*              watertight ray-triangle test.                   *
+***************************************************************/
+
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "hittable.h"
+#include "bvh.h"
+#include "stats.h"
+
+#include <cstdint> // Include necessary standard library headers.
+#include <utility>
+#include <vector>
+
+// Vertex and index buffers of a mesh: packed x, y, z positions and three vertex indices per
+// triangle. Positions are stored without vec3 padding to keep large meshes small.
+struct mesh_buffers {
+    std::vector<real> positions; // x, y, z of each vertex.
+    std::vector<uint32_t> indices; // Three vertex indices per triangle.
+
+    size_t vertex_count() const { return positions.size() / 3; }
+    size_t triangle_count() const { return indices.size() / 3; }
+    point3 vertex(uint32_t i) const { return point3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]); }
+};
+
+// Per-ray setup of the watertight ray-triangle test (Woop, Benthin and Wald, "Watertight
+// Ray/Triangle Intersection", JCGT 2013). The ray is turned so that its dominant axis becomes z
+// and sheared onto +z; triangles are then tested with 2D edge functions, which never let a ray
+// slip between two triangles sharing an edge.
+struct watertight_ray {
+    point3 origin; // Ray origin.
+    int kx, ky, kz; // Axis permutation: kz is the dominant direction axis.
+    real sx, sy, sz; // Shear constants.
+
+    explicit watertight_ray(const ray& r) : origin(r.origin()) {
+        const vec3& d = r.direction();
+        kz = (std::fabs(d[0]) > std::fabs(d[1])) ? (std::fabs(d[0]) > std::fabs(d[2]) ? 0 : 2) : (std::fabs(d[1]) > std::fabs(d[2]) ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        if (d[kz] < 0) {
+            std::swap(kx, ky); // Keep the winding, so the sign test below stays consistent.
+        }
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1 / d[kz];
+    }
+
+    // Test a triangle; on a hit within ray_t, t receives the ray parameter.
+    bool hit(const point3& p0, const point3& p1, const point3& p2, const interval& ray_t, real& t) const {
+        vec3 a = p0 - origin, b = p1 - origin, c = p2 - origin; // Vertices relative to the ray origin.
+        real ax = a[kx] - sx * a[kz], ay = a[ky] - sy * a[kz]; // Sheared vertices.
+        real bx = b[kx] - sx * b[kz], by = b[ky] - sy * b[kz];
+        real cx = c[kx] - sx * c[kz], cy = c[ky] - sy * c[kz];
+
+        real u = cx * by - cy * bx; // Edge functions (scaled barycentric coordinates).
+        real v = ax * cy - ay * cx;
+        real w = bx * ay - by * ax;
+        if (sizeof(real) < sizeof(double) && (u == 0 || v == 0 || w == 0)) {
+            // Exactly on an edge in float: decide in double so neighbours agree.
+            u = real(double(cx) * by - double(cy) * bx);
+            v = real(double(ax) * cy - double(ay) * cx);
+            w = real(double(bx) * ay - double(by) * ax);
+        }
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) {
+            return false; // The ray passes outside an edge.
+        }
+        real det = u + v + w;
+        if (det == 0) {
+            return false; // Ray parallel to the triangle, or a degenerate triangle.
+        }
+
+        real depth = u * (sz * a[kz]) + v * (sz * b[kz]) + w * (sz * c[kz]); // Scaled hit distance.
+        t = depth / det;
+        return ray_t.surrounds(t);
+    }
+};
+
+// Class representing a triangle mesh. Triangles are kept in BVH leaf order and share their
+// vertices; one mesh can be drawn many times through instances without copying it.
+class triangle_mesh : public hittable {
+public:
+    // Constructors:
+    triangle_mesh(mesh_buffers buffers, const bvh_build_options& options = bvh_build_options()) : mesh(std::move(buffers)) {
+        size_t count = mesh.triangle_count();
+        std::vector<aabb> boxes;
+        boxes.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            aabb box(aabb(mesh.vertex(mesh.indices[3 * i]), mesh.vertex(mesh.indices[3 * i + 1])), aabb(mesh.vertex(mesh.indices[3 * i + 2]), mesh.vertex(mesh.indices[3 * i + 2])));
+            bbox = aabb(bbox, box);
+            boxes.push_back(box);
+        }
+
+        std::vector<int> order;
+        nodes = bvh_builder(boxes, options).build(order);
+
+        std::vector<uint32_t> sorted(mesh.indices.size()); // Index triples in leaf order.
+        for (size_t k = 0; k < order.size(); k++) {
+            for (int j = 0; j < 3; j++) {
+                sorted[3 * k + j] = mesh.indices[3 * size_t(order[k]) + j];
+            }
+        }
+        mesh.indices.swap(sorted);
+    }
+
+    // Method to check for ray-triangle intersection with the closest triangle of the mesh.
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        watertight_ray wr(r);
+        int best = -1;
+        real best_t = 0;
+        bvh_traverse(nodes.data(), int(nodes.size()), r, ray_t, [&](int first, int count, interval& t) {
+            return closest_in_leaf(wr, first, count, t, best, best_t);
+        });
+        if (best < 0) {
+            return false;
+        }
+        record_hit(r, best, best_t, rec);
+        return true;
+    }
+
+    // Method to trace a packet of rays together, sharing node tests across the packet.
+    void hit_packet(const ray* rays, int count, interval ray_t, hit_record* recs, bool* hits) const override {
+        RT_STAT_ADD(hit_calls, 1);
+        bvh_packet p(rays, count, ray_t.max);
+        int best[max_packet_size];
+        real best_t[max_packet_size];
+        for (int k = 0; k < count; k++) {
+            best[k] = -1;
+        }
+        bvh_traverse_packet(nodes.data(), int(nodes.size()), p, ray_t.min, kernel, [&](int first, int n, int k) {
+            interval t(ray_t.min, real(p.t_max[k]));
+            if (closest_in_leaf(watertight_ray(rays[k]), first, n, t, best[k], best_t[k])) {
+                p.t_max[k] = t.max; // Only closer hits count from now on.
+            }
+        });
+        for (int k = 0; k < count; k++) {
+            hits[k] = best[k] >= 0;
+            if (hits[k]) {
+                record_hit(rays[k], best[k], best_t[k], recs[k]);
+            }
+        }
+    }
+
+    // Method to check whether the ray hits any triangle, stopping at the first one found.
+    bool any_hit(const ray& r, interval ray_t) const override {
+        watertight_ray wr(r);
+        return bvh_traverse<true>(nodes.data(), int(nodes.size()), r, ray_t, [&](int first, int count, interval& t) {
+            real hit_t;
+            for (int i = first; i < first + count; i++) {
+                if (wr.hit(corner(i, 0), corner(i, 1), corner(i, 2), t, hit_t)) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    // Method returning the bounding box of the mesh.
+    aabb bounding_box() const override { return bbox; }
+
+    // The mesh's buffers (triangles in BVH leaf order).
+    const mesh_buffers& buffers() const { return mesh; }
+    size_t triangle_count() const { return mesh.triangle_count(); }
+
+private:
+    mesh_buffers mesh; // Vertex positions and triangles in leaf order.
+    std::vector<bvh_node> nodes; // Flattened BVH over the triangles.
+    aabb bbox; // Bounding box of all triangles.
+    simd_level kernel = detect_simd_level(); // Packet node kernel.
+
+    // Corner j of triangle i.
+    point3 corner(int i, int j) const { return mesh.vertex(mesh.indices[3 * size_t(i) + j]); }
+
+    // Test the triangles [first, first + count) and keep the closest hit in best / best_t,
+    // shrinking t.max. Returns whether any triangle was hit.
+    bool closest_in_leaf(const watertight_ray& wr, int first, int count, interval& t, int& best, real& best_t) const {
+        bool hit_anything = false;
+        real hit_t;
+        for (int i = first; i < first + count; i++) {
+            if (wr.hit(corner(i, 0), corner(i, 1), corner(i, 2), t, hit_t)) {
+                hit_anything = true;
+                best = i;
+                best_t = hit_t;
+                t.max = hit_t;
+            }
+        }
+        return hit_anything;
+    }
+
+    // Fill in a hit record for triangle i at distance t, with the geometric normal.
+    void record_hit(const ray& r, int i, real t, hit_record& rec) const {
+        point3 p0 = corner(i, 0);
+        vec3 outward_normal = unit_vector(cross(corner(i, 1) - p0, corner(i, 2) - p0)); // Counter-clockwise winding faces out.
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.set_face_normal(r, outward_normal);
+    }
+};
+
+#endif // TRIANGLE_MESH_H
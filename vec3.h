@@ -8,124 +8,213 @@
 
 #include "rt_general.h" // Include necessary header files.
 
-// Define a class for 3D vectors.
-class vec3 {
+// Storage layout of a vector's components. Float vectors carry a fourth, always-zero component
+// and 16-byte alignment, so one vector fills one SIMD register and component loops vectorize.
+template <typename T>
+struct vec3_storage {
+    static constexpr int lanes = 3;
+    static constexpr size_t align = alignof(T);
+};
+
+template <>
+struct vec3_storage<float> {
+    static constexpr int lanes = 4;
+    static constexpr size_t align = 16;
+};
+
+// Define a class template for 3D vectors with components of type T.
+template <typename T>
+class basic_vec3 {
 public:
-    double e[3]; // Array to store the vector components.
+    using scalar = T; // Component type.
+    static constexpr int lanes = vec3_storage<T>::lanes; // Stored components (3, or 4 with padding).
+
+    alignas(vec3_storage<T>::align) T e[lanes]; // Array to store the vector components.
 
     // Constructors:
-    vec3() : e{0,0,0} {}
-    vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+    basic_vec3() : e{} {}
+    basic_vec3(T e0, T e1, T e2) : e{e0, e1, e2} {}
+    template <typename U>
+    explicit basic_vec3(const basic_vec3<U>& v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {} // Change precision.
 
     // Accessor functions for vector components.
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
 
     // Overloaded operators:
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); } // Negation operator (vector negate).
-    double operator[](int i) const { return e[i]; } // Array access operator (access vector coordinates).
-    double& operator[](int i) { return e[i]; } // Array operator returning a reference to vector coordinates.
+    basic_vec3 operator-() const { return basic_vec3(-e[0], -e[1], -e[2]); } // Negation operator (vector negate).
+    T operator[](int i) const { return e[i]; } // Array access operator (access vector coordinates).
+    T& operator[](int i) { return e[i]; } // Array operator returning a reference to vector coordinates.
 
     // Compound assignment operators:
-    vec3& operator+=(const vec3 v) {
-        e[0] += v.e[0];
-        e[1] += v.e[1];
-        e[2] += v.e[2];
+    basic_vec3& operator+=(const basic_vec3& v) {
+        for (int i = 0; i < lanes; i++) {
+            e[i] += v.e[i];
+        }
         return *this; // Return a reference to the modified vector.
     }
 
-    vec3& operator*=(double t) {
-        e[0] *= t;
-        e[1] *= t;
-        e[2] *= t;
+    basic_vec3& operator*=(T t) {
+        for (int i = 0; i < lanes; i++) {
+            e[i] *= t;
+        }
         return *this;
     }
 
-    vec3& operator/=(double t) {
+    basic_vec3& operator/=(T t) {
         return *this *= (1 / t);
     }
 
     // Vector length calculation:
-    double length() const {
-        return sqrt(length_squared());
+    T length() const {
+        return std::sqrt(length_squared());
     }
 
     // Squared vector length calculation (faster than length()).
-    double length_squared() const {
+    T length_squared() const {
         return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
     }
 
     // Static methods for generating random vectors:
-    static vec3 random();
-    static vec3 random(double min, double max);
+    static basic_vec3 random(rng& gen) {
+        T x = T(random_double(gen)); // Draw in a fixed order so results do not depend on the compiler.
+        T y = T(random_double(gen));
+        T z = T(random_double(gen));
+        return basic_vec3(x, y, z);
+    }
+
+    static basic_vec3 random(rng& gen, double min, double max) {
+        T x = T(random_double(gen, min, max));
+        T y = T(random_double(gen, min, max));
+        T z = T(random_double(gen, min, max));
+        return basic_vec3(x, y, z);
+    }
+
+    static basic_vec3 random() { return random(thread_rng()); }
+    static basic_vec3 random(double min, double max) { return random(thread_rng(), min, max); }
 };
 
+// Vectors in the precision the renderer was built with.
+using vec3 = basic_vec3<real>;
+
 // Alias for 3D points.
 using point3 = vec3;
 
-// Utility functions for vector operations:
+// Utility functions for vector operations. Scalar arguments take the vector's component type
+// (they are not deduced), so a double constant scales a float vector without a cast.
 
 // Output stream operator for vectors.
-inline std::ostream& operator<<(std::ostream& out, const vec3& v) {
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const basic_vec3<T>& v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
 // Addition of two vectors.
-inline vec3 operator+(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator+(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    basic_vec3<T> r;
+    for (int i = 0; i < basic_vec3<T>::lanes; i++) {
+        r.e[i] = u.e[i] + v.e[i];
+    }
+    return r;
 }
 
 // Subtraction of two vectors.
-inline vec3 operator-(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator-(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    basic_vec3<T> r;
+    for (int i = 0; i < basic_vec3<T>::lanes; i++) {
+        r.e[i] = u.e[i] - v.e[i];
+    }
+    return r;
+}
+
+// Component-wise multiplication of two vectors.
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    basic_vec3<T> r;
+    for (int i = 0; i < basic_vec3<T>::lanes; i++) {
+        r.e[i] = u.e[i] * v.e[i];
+    }
+    return r;
 }
 
 // Scalar multiplication of a vector.
-inline vec3 operator*(double t, const vec3& v) {
-    return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+template <typename T>
+inline basic_vec3<T> operator*(typename basic_vec3<T>::scalar t, const basic_vec3<T>& v) {
+    basic_vec3<T> r;
+    for (int i = 0; i < basic_vec3<T>::lanes; i++) {
+        r.e[i] = t * v.e[i];
+    }
+    return r;
+}
+
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T>& v, typename basic_vec3<T>::scalar t) {
+    return t * v;
 }
 
 // Scalar division of a vector.
-inline vec3 operator/(const vec3& v, double t) {
-    return vec3(v.e[0]/t, v.e[1]/t, v.e[2]/t);
+template <typename T>
+inline basic_vec3<T> operator/(const basic_vec3<T>& v, typename basic_vec3<T>::scalar t) {
+    basic_vec3<T> r;
+    for (int i = 0; i < basic_vec3<T>::lanes; i++) {
+        r.e[i] = v.e[i] / t;
+    }
+    return r;
 }
 
 // Dot product of two vectors.
-inline double dot(const vec3& u, const vec3& v) {
+template <typename T>
+inline T dot(const basic_vec3<T>& u, const basic_vec3<T>& v) {
     return u.e[0] * v.e[0] + u.e[1] * v.e[1] + u.e[2] * v.e[2];
 }
 
 // Cross product of two vectors.
-inline vec3 cross(const vec3& u, const vec3& v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-                u.e[2] * v.e[0] - u.e[0] * v.e[2],
-                u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+template <typename T>
+inline basic_vec3<T> cross(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                         u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                         u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
 // Normalization of a vector.
-inline vec3 unit_vector(const vec3& v) {
+template <typename T>
+inline basic_vec3<T> unit_vector(const basic_vec3<T>& v) {
     return v / v.length();
 }
 
 // Generate a random point in a unit sphere.
-inline vec3 random_in_unit_sphere() {
+inline vec3 random_in_unit_sphere(rng& gen) {
     while (true) {
-        auto p = vec3::random(-1,1);
+        auto p = vec3::random(gen, -1,1);
         if (p.length_squared() < 1) {
             return p;
         }
     }
 }
 
-// Generate a random unit vector.
-inline vec3 random_unit_vector() {
-    return unit_vector(random_in_unit_sphere());
+// A direction distributed uniformly over the unit sphere, mapped directly from a point (u1, u2)
+// of the unit square: z is uniform on [-1, 1] (Archimedes), the angle around z uniform.
+inline vec3 sample_uniform_sphere(double u1, double u2) {
+    double z = 1 - 2 * u1;
+    double r = std::sqrt(std::fmax(0.0, 1 - z * z));
+    double phi = 2 * pi * u2;
+    return vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+// Generate a random unit vector from two draws, without the rejection loop of a point in the
+// unit sphere (which throws away about 48% of its candidates).
+inline vec3 random_unit_vector(rng& gen) {
+    double u1 = gen.next_double(); // Drawn in a fixed order so results do not depend on the compiler.
+    double u2 = gen.next_double();
+    return sample_uniform_sphere(u1, u2);
 }
 
 // Generate a random point on a hemisphere given a normal vector.
-inline vec3 random_on_hemisphere(const vec3& normal) {
-    vec3 on_unit_sphere = random_unit_vector();
+inline vec3 random_on_hemisphere(rng& gen, const vec3& normal) {
+    vec3 on_unit_sphere = random_unit_vector(gen);
     if (dot(on_unit_sphere, normal) > 0.0) {
         return on_unit_sphere;
     }
@@ -134,4 +223,48 @@ inline vec3 random_on_hemisphere(const vec3& normal) {
     }
 }
 
-#endif
\ No newline at end of file
+// Two unit vectors t and b that make a right-handed orthonormal basis (t, b, n) with the unit
+// vector n, without branches or normalization (Duff et al., JCGT 2017).
+inline void orthonormal_basis(const vec3& n, vec3& t, vec3& b) {
+    real sign = std::copysign(real(1), n.z());
+    real a = -1 / (sign + n.z());
+    real c = n.x() * n.y() * a;
+    t = vec3(1 + sign * n.x() * n.x() * a, sign * c, -sign * n.x());
+    b = vec3(c, sign + n.y() * n.y() * a, -n.y());
+}
+
+// A direction distributed uniformly over the hemisphere around the unit vector normal, mapped
+// directly from a point (u1, u2) of the unit square. Like random_unit_vector, it consumes
+// exactly two numbers and keeps the square's stratification, since the mapping preserves area.
+inline vec3 sample_uniform_hemisphere(double u1, double u2, const vec3& normal) {
+    double z = u1; // cos(theta) is uniform on a uniform hemisphere.
+    double r = std::sqrt(std::fmax(0.0, 1 - z * z));
+    double phi = 2 * pi * u2;
+    vec3 t, b;
+    orthonormal_basis(normal, t, b);
+    return (r * std::cos(phi)) * t + (r * std::sin(phi)) * b + z * normal;
+}
+
+// A direction distributed over the hemisphere around the unit vector normal with density
+// cosine_hemisphere_pdf, the importance sampling of a Lambertian surface: a uniform point of the
+// unit disk (Malley's method) lifted onto the hemisphere.
+inline vec3 sample_cosine_hemisphere(double u1, double u2, const vec3& normal) {
+    double r = std::sqrt(u1);
+    double phi = 2 * pi * u2;
+    vec3 t, b;
+    orthonormal_basis(normal, t, b);
+    return (r * std::cos(phi)) * t + (r * std::sin(phi)) * b + std::sqrt(std::fmax(0.0, 1 - u1)) * normal;
+}
+
+// Density of sample_cosine_hemisphere for a direction at cos_theta to the normal: cos(theta) / pi.
+// A Lambertian bounce weighted by it has throughput albedo * cos / pi / pdf = albedo.
+inline double cosine_hemisphere_pdf(double cos_theta) {
+    return std::fmax(0.0, cos_theta) / pi;
+}
+
+// Overloads drawing from the calling thread's generator.
+inline vec3 random_in_unit_sphere() { return random_in_unit_sphere(thread_rng()); }
+inline vec3 random_unit_vector() { return random_unit_vector(thread_rng()); }
+inline vec3 random_on_hemisphere(const vec3& normal) { return random_on_hemisphere(thread_rng(), normal); }
+
+#endif
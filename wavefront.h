@@ -0,0 +1,168 @@
+/***************************************************************
+* Description: Header file for the wavefront engine's data:    *
+*              structure-of-arrays path queues and the sorting *
+*              of rays between bounces.                        *
+***************************************************************/
+
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "rt_general.h" // Include necessary header files.
+#include "aabb.h"
+#include "hittable.h"
+#include "sampler.h"
+
+#include <algorithm> // Include necessary standard library headers.
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// How the wavefront engine orders the paths of a wave before each bounce.
+enum class ray_sort {
+    none, // Keep the order the paths were generated in.
+    direction, // Group rays by direction, so neighbours in the queue traverse the same BVH nodes.
+    origin // Group rays by origin along a Morton curve through the scene bounds.
+};
+
+// Settings of the wavefront engine.
+struct wavefront_options {
+    int queue_size = 1 << 14; // Paths in flight per thread; a tile's samples are split into waves of about this many.
+    ray_sort sort = ray_sort::direction; // Ray order for bounces.
+};
+
+// Paths in flight, structure-of-arrays: each stage streams through the arrays it needs.
+struct path_queue {
+    std::vector<real> ox, oy, oz; // Origin of each path's next ray.
+    std::vector<real> dx, dy, dz; // Direction of each path's next ray.
+    std::vector<real> tr, tg, tb; // Throughput: fraction of light carried back along the path so far.
+    std::vector<pixel_sampler> samplers; // Sampler of each path's sample.
+    std::vector<uint32_t> slots; // Result slot of each path (pixel and sample of the wave).
+
+    size_t size() const { return slots.size(); }
+
+    void clear() {
+        for (auto* v : {&ox, &oy, &oz, &dx, &dy, &dz, &tr, &tg, &tb}) {
+            v->clear();
+        }
+        samplers.clear();
+        slots.clear();
+    }
+
+    // Add a path.
+    void push(const ray& r, const color& throughput, const pixel_sampler& sampler, uint32_t slot) {
+        ox.push_back(r.origin().x());
+        oy.push_back(r.origin().y());
+        oz.push_back(r.origin().z());
+        dx.push_back(r.direction().x());
+        dy.push_back(r.direction().y());
+        dz.push_back(r.direction().z());
+        tr.push_back(throughput.x());
+        tg.push_back(throughput.y());
+        tb.push_back(throughput.z());
+        samplers.push_back(sampler);
+        slots.push_back(slot);
+    }
+
+    // Accessor functions for a path's ray and throughput.
+    ray ray_at(size_t i) const { return ray(point3(ox[i], oy[i], oz[i]), vec3(dx[i], dy[i], dz[i])); }
+    color throughput_at(size_t i) const { return color(tr[i], tg[i], tb[i]); }
+
+    // Replace the contents with the paths of from, in the given order.
+    void gather(const path_queue& from, const std::vector<uint32_t>& order) {
+        size_t n = order.size();
+        auto copy = [&](std::vector<real>& to, const std::vector<real>& src) {
+            to.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                to[i] = src[order[i]];
+            }
+        };
+        copy(ox, from.ox); copy(oy, from.oy); copy(oz, from.oz);
+        copy(dx, from.dx); copy(dy, from.dy); copy(dz, from.dz);
+        copy(tr, from.tr); copy(tg, from.tg); copy(tb, from.tb);
+        samplers.resize(n);
+        slots.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            samplers[i] = from.samplers[order[i]];
+            slots[i] = from.slots[order[i]];
+        }
+    }
+};
+
+// Working memory of a thread's wavefront engine, kept from tile to tile.
+struct wavefront_buffers {
+    path_queue queue, next; // Paths of the current bounce, and the survivors for the next one.
+    std::vector<hit_record> recs; // Closest hit of each path's ray in the current bounce.
+    std::vector<uint8_t> hits; // Whether each path's ray hit anything.
+    std::vector<color> results; // Radiance of each finished path, by slot.
+    std::vector<int> lengths; // Rays traced for each path, by slot.
+    std::vector<uint32_t> keys, order, scratch; // Sorting state.
+};
+
+inline wavefront_buffers& thread_wavefront_buffers() {
+    thread_local wavefront_buffers buffers;
+    return buffers;
+}
+
+// Spread the low 10 bits of x so two zero bits follow each (for interleaving three coordinates).
+inline uint32_t spread_bits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// 30-bit Morton code of a point given in [0, 1] per axis.
+inline uint32_t morton_key(double x, double y, double z) {
+    auto quantize = [](double v) { return uint32_t(std::min(std::max(v * 1024.0, 0.0), 1023.0)); };
+    return (spread_bits(quantize(x)) << 2) | (spread_bits(quantize(y)) << 1) | spread_bits(quantize(z));
+}
+
+// Sort keys of the paths in a queue: the Morton code of the ray direction on the cube [-1, 1]^3
+// (so the octant comes first), or of the origin within the scene bounds.
+inline void sort_keys(const path_queue& queue, ray_sort sort, const aabb& bounds, std::vector<uint32_t>& keys) {
+    size_t n = queue.size();
+    keys.resize(n);
+    if (sort == ray_sort::direction) {
+        for (size_t i = 0; i < n; i++) {
+            double scale = 0.5 / std::max({std::fabs(double(queue.dx[i])), std::fabs(double(queue.dy[i])), std::fabs(double(queue.dz[i])), 1e-30});
+            keys[i] = morton_key(queue.dx[i] * scale + 0.5, queue.dy[i] * scale + 0.5, queue.dz[i] * scale + 0.5);
+        }
+        return;
+    }
+    auto inverse = [](const interval& axis) { return axis.size() > 0 ? 1 / double(axis.size()) : 0.0; };
+    double ix = inverse(bounds.x), iy = inverse(bounds.y), iz = inverse(bounds.z);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = morton_key((queue.ox[i] - bounds.x.min) * ix, (queue.oy[i] - bounds.y.min) * iy, (queue.oz[i] - bounds.z.min) * iz);
+    }
+}
+
+// Order the indices of keys by key with a stable least-significant-digit radix sort (three passes
+// of 10 bits). scratch is working space.
+inline void radix_sort_order(const std::vector<uint32_t>& keys, std::vector<uint32_t>& order, std::vector<uint32_t>& scratch) {
+    size_t n = keys.size();
+    order.resize(n);
+    scratch.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        order[i] = uint32_t(i);
+    }
+    for (int shift = 0; shift < 30; shift += 10) {
+        uint32_t offsets[1024] = {};
+        for (size_t i = 0; i < n; i++) {
+            offsets[(keys[i] >> shift) & 1023]++; // Counts do not depend on the order.
+        }
+        uint32_t total = 0;
+        for (uint32_t& offset : offsets) {
+            uint32_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for (size_t i = 0; i < n; i++) {
+            scratch[offsets[(keys[order[i]] >> shift) & 1023]++] = order[i];
+        }
+        order.swap(scratch);
+    }
+}
+
+#endif // WAVEFRONT_H